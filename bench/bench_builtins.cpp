@@ -0,0 +1,63 @@
+// Measures the latency of builtin commands run from a script, alone and in
+// pipelines, for each shell binary given on the command line (e.g. a build
+// from before and after a change). Script lines are cached by the parser, so
+// the numbers are dominated by how a builtin is dispatched.
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kLines = 2000;
+const char* kScript = "bench_builtins.sh";
+const std::vector<std::string> kCommands = {
+    "echo hi", "pwd", "type echo", "echo a | echo b", "echo hi | cat",
+};
+
+// Runs `shell` on a script repeating `command` and returns the microseconds
+// per line, or -1 if the shell failed.
+double MicrosPerLine(const std::string& shell, const std::string& command) {
+  {
+    std::ofstream file{kScript};
+    for (int i = 0; i < kLines; i++) file << command << '\n';
+  }
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    int out = open("/dev/null", O_WRONLY);
+    dup2(out, STDOUT_FILENO);
+    execl(shell.c_str(), shell.c_str(), kScript, nullptr);
+    _exit(127);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  auto end = std::chrono::steady_clock::now();
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) return -1;
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         kLines;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> shells(argv + 1, argv + argc);
+  if (shells.empty()) shells.push_back("./shell");
+  std::printf("%-18s", "command (us/line)");
+  for (const auto& shell : shells) std::printf(" %24s", shell.c_str());
+  std::printf("\n");
+  for (const auto& command : kCommands) {
+    std::printf("%-18s", command.c_str());
+    for (const auto& shell : shells) {
+      std::printf(" %24.1f", MicrosPerLine(shell, command));
+    }
+    std::printf("\n");
+  }
+  std::remove(kScript);
+  return 0;
+}
@@ -0,0 +1,165 @@
+// Loads a 1M-line history file into a 100-entry History, comparing inserting
+// every line read with std::getline against mapping the file and keeping only
+// its last lines. Also times appending one command to the history file and
+// merging one command another session appended to the 1M-line file, C-r
+// keystrokes against 1M loaded entries, and the `history` builtin listing
+// them, built as one string as it used to be and streamed through a sink.
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <ios>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "history.hpp"
+#include "io.hpp"
+
+namespace fs = std::filesystem;
+namespace shist = shell::history;
+
+namespace {
+
+constexpr int kLines = 1000000;
+constexpr size_t kMaxSize = 100;
+// The old `history` builtin is quadratic; keep it to a size that finishes.
+constexpr size_t kStringEntries = 20000;
+
+// History::load before it mapped the file.
+void GetlineLoad(shist::History* history, const std::string& filename) {
+  std::ifstream read_file{filename};
+  std::string line;
+  while (std::getline(read_file, line)) {
+    if (!line.empty()) history->insert(line);
+  }
+}
+
+// The `history` builtin before it streamed its output.
+std::string StringHistory(const shist::History& history) {
+  std::string res = "";
+  for (size_t i = 0; i < history.size; i++) {
+    res = res + "    " + std::to_string(i + 1) + "  " +
+          std::string(history[i]) + '\n';
+  }
+  return res;
+}
+
+long PeakRssKb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+template <typename F>
+double MicrosPerCall(int iterations, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+int main() {
+  fs::path root = fs::temp_directory_path() / "shell_bench_history";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  std::string filename = (root / "history").string();
+  {
+    std::ofstream file{filename};
+    for (int i = 0; i < kLines; i++) {
+      file << "git commit -m 'change number " << i << "'\n";
+    }
+  }
+
+  auto getline_load = [&] {
+    shist::History history{kMaxSize};
+    GetlineLoad(&history, filename);
+  };
+  auto mapped_load = [&] {
+    shist::History history{kMaxSize};
+    history.load(filename);
+  };
+  std::string append_file = (root / "append").string();
+  shist::History session{kMaxSize};
+  session.attach(append_file);
+  auto append = [&] {
+    session.insert("ls -la");
+    session.persist();
+  };
+
+  shist::History reader{kMaxSize};
+  reader.attach(filename);
+  shist::History writer{kMaxSize};
+  writer.attach(filename);
+  auto merge = [&] {
+    writer.insert("make test");
+    writer.persist();
+    if (reader.merge() != 1) std::abort();
+  };
+
+  shist::History big{kLines};
+  big.load(filename);
+  // Each prefix is one keystroke of an incremental search.
+  std::vector<std::string> keystrokes;
+  for (std::string query : {"number 4242", "commit -m", "change number 99999"}) {
+    for (size_t i = 1; i <= query.size(); i++) {
+      keystrokes.push_back(query.substr(0, i));
+    }
+  }
+  keystrokes.push_back("no such command");
+  double worst = 0;
+  for (const auto& query : keystrokes) {
+    worst = std::max(worst, MicrosPerCall(20, [&] {
+                       big.search(query, big.size);
+                     }));
+  }
+  auto miss = [&] {
+    if (big.search("no such command", big.size) != big.size) std::abort();
+  };
+
+  int null_fd = open("/dev/null", O_WRONLY);
+  auto list = [&](const shist::History* history) {
+    shist::GLOBAL_HISTORY = const_cast<shist::History*>(history);
+    shell::io::OutputSink out{null_fd};
+    shist::HistoryCommand({}, &out);
+  };
+  // Measured first, while the peak is still the loaded history itself.
+  long rss_before = PeakRssKb();
+  double sink_big = MicrosPerCall(5, [&] { list(&big); });
+  long rss_growth = PeakRssKb() - rss_before;
+  shist::History small{kStringEntries};
+  small.load(filename);
+  double sink_small = MicrosPerCall(20, [&] { list(&small); });
+  double string_small = MicrosPerCall(1, [&] {
+    std::string res = StringHistory(small);
+    shell::io::WriteAll(null_fd, res);
+  });
+  close(null_fd);
+
+  std::printf("%-28s %12s\n", "operation", "us/call");
+  std::printf("%-28s %12.1f\n", "getline load (1M lines)",
+              MicrosPerCall(5, getline_load));
+  std::printf("%-28s %12.1f\n", "mmap load (1M lines)",
+              MicrosPerCall(200, mapped_load));
+  std::printf("%-28s %12.1f\n", "insert + O_APPEND persist",
+              MicrosPerCall(10000, append));
+  std::printf("%-28s %12.1f\n", "merge one new command",
+              MicrosPerCall(10000, merge));
+  std::printf("%-28s %12.1f\n", "C-r keystroke, worst (1M)", worst);
+  std::printf("%-28s %12.1f\n", "C-r miss (1M)", MicrosPerCall(1000, miss));
+  std::printf("%-28s %12.1f\n", "history, string (20k)", string_small);
+  std::printf("%-28s %12.1f\n", "history, sink (20k)", sink_small);
+  std::printf("%-28s %12.1f\n", "history, sink (1M)", sink_big);
+  std::printf("%-28s %12ld\n", "history, sink peak RSS +KiB", rss_growth);
+  fs::remove_all(root);
+  return 0;
+}
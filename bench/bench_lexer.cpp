@@ -0,0 +1,140 @@
+// Parses long, heavily quoted command lines, comparing a naive split into
+// copied stages and words, the way the shell used to chain string passes,
+// with a single Lexer pass, and building the AST with and without the parse
+// cache.
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+
+namespace slex = shell::lexer;
+namespace sparse = shell::parser;
+
+namespace {
+
+constexpr int kArgs = 200;
+
+template <typename F>
+double MicrosPerCall(int iterations, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+std::string QuotedLine() {
+  std::string line = "cat";
+  for (int i = 0; i < kArgs; i++) {
+    switch (i % 4) {
+      case 0:
+        line += " '/tmp/bee/f   " + std::to_string(i) + "'";
+        break;
+      case 1:
+        line += " \"/tmp/pig/\\\"f " + std::to_string(i) + "\\\"\"";
+        break;
+      case 2:
+        line += " plain" + std::to_string(i);
+        break;
+      case 3:
+        line += " with\\ \\ escaped\\ " + std::to_string(i);
+        break;
+    }
+  }
+  return line + " | grep 'f   1' | wc -l > out.txt";
+}
+
+// Splits `line` into stages on unquoted pipes, then each stage into words,
+// honoring quotes and backslashes and copying every piece along the way.
+std::vector<std::vector<std::string>> NaiveSplit(const std::string& line) {
+  std::vector<std::string> stages(1);
+  char quote = 0;
+  for (size_t i = 0; i < line.size(); i++) {
+    char c = line[i];
+    if (quote == 0 && c == '|') {
+      stages.emplace_back();
+      continue;
+    }
+    if (c == '\\' && quote != '\'' && i + 1 < line.size()) {
+      stages.back() += c;
+      c = line[++i];
+    } else if (quote == 0 && (c == '\'' || c == '"')) {
+      quote = c;
+    } else if (c == quote) {
+      quote = 0;
+    }
+    stages.back() += c;
+  }
+  std::vector<std::vector<std::string>> res;
+  for (const auto& stage : stages) {
+    std::vector<std::string> words;
+    std::string word;
+    bool in_word = false;
+    quote = 0;
+    for (size_t i = 0; i < stage.size(); i++) {
+      char c = stage[i];
+      if (quote == 0 && c == ' ') {
+        if (in_word) words.push_back(word);
+        word.clear();
+        in_word = false;
+        continue;
+      }
+      in_word = true;
+      if (c == '\\' && quote != '\'' && i + 1 < stage.size()) {
+        word += stage[++i];
+      } else if (quote == 0 && (c == '\'' || c == '"')) {
+        quote = c;
+      } else if (c == quote) {
+        quote = 0;
+      } else {
+        word += c;
+      }
+    }
+    if (in_word) words.push_back(word);
+    res.push_back(std::move(words));
+  }
+  return res;
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::off);
+  std::string line = QuotedLine();
+  size_t words = 0;
+  auto naive = [&] {
+    for (const auto& stage : NaiveSplit(line)) words += stage.size();
+  };
+  slex::Lexer lexer;
+  auto single_pass = [&] { words += lexer.lex(line).size(); };
+  sparse::Parser parser;
+  size_t misses = 0;
+  // A trailing comment makes every line distinct without changing the AST.
+  auto uncached = [&] {
+    words += parser.parse(line + " #" + std::to_string(misses++))
+                 .pipelines.size();
+  };
+  auto cached = [&] { words += parser.parse(line).pipelines.size(); };
+
+  std::printf("line of %zu bytes\n", line.size());
+  std::printf("%-28s %12s %12s\n", "parser", "us/line", "MB/s");
+  double old_us = MicrosPerCall(2000, naive);
+  double new_us = MicrosPerCall(20000, single_pass);
+  std::printf("%-28s %12.2f %12.1f\n", "naive split", old_us,
+              line.size() / old_us);
+  std::printf("%-28s %12.2f %12.1f\n", "lexer", new_us, line.size() / new_us);
+  double parse_us = MicrosPerCall(20000, uncached);
+  double hit_us = MicrosPerCall(20000, cached);
+  std::printf("%-28s %12.2f %12.1f\n", "lexer + parser", parse_us,
+              line.size() / parse_us);
+  std::printf("%-28s %12.2f %12.1f\n", "parse cache hit", hit_us,
+              line.size() / hit_us);
+  std::printf("lexer speedup over naive split: %.1fx\n", old_us / new_us);
+  return words == 0;
+}
@@ -0,0 +1,63 @@
+// Measures parsing and the code paths that used to log per node
+// (Trie::insert, Trie::contains) with tracing off. Built twice: bench_logging
+// with the debug statements compiled out, the default, and
+// bench_logging_checked with them compiled in and only disabled at runtime,
+// which is what every build used to pay for.
+#include <spdlog/spdlog.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "parser.hpp"
+#include "trie.hpp"
+
+namespace {
+
+constexpr int kIterations = 200000;
+constexpr int kWords = 50000;
+// More distinct lines than the parse cache holds, so every parse misses.
+constexpr size_t kLines = 2 * shell::parser::kParseCacheSize;
+
+template <typename F>
+double NanosPerCall(int iterations, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f(i);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+int main() {
+  spdlog::set_level(spdlog::level::info);
+  std::vector<std::string> words;
+  for (int i = 0; i < kWords; i++) {
+    words.push_back("command-" + std::to_string(i * 7919 % 100003));
+  }
+  std::vector<std::string> lines;
+  for (size_t i = 0; i < kLines; i++) {
+    lines.push_back("grep -n \"hello world\" 'some file.txt' src/main.cpp" +
+                    std::to_string(i) + " 2>/dev/null | sort -u > out");
+  }
+  size_t sink = 0;
+  shell::parser::Parser parser;
+  double parse = NanosPerCall(kIterations, [&](int i) {
+    sink += parser.parse(lines[i % kLines]).pipelines.size();
+  });
+  Trie trie;
+  double insert = NanosPerCall(kWords, [&](int i) { trie.insert(words[i]); });
+  double contains = NanosPerCall(kIterations, [&](int i) {
+    sink += trie.contains(words[i % kWords]);
+  });
+  std::printf("debug logging %s\n", SPDLOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+                                        ? "compiled in, level info"
+                                        : "compiled out");
+  std::printf("%-20s %10s\n", "operation", "ns/call");
+  std::printf("%-20s %10.1f\n", "lex + parse", parse);
+  std::printf("%-20s %10.1f\n", "Trie::insert", insert);
+  std::printf("%-20s %10.1f\n", "Trie::contains", contains);
+  return sink == 0;
+}
@@ -0,0 +1,62 @@
+// Measures what the profiling hooks cost: a Scope with profiling off, which
+// is what every command pays, and with it on, and Histogram::record from
+// several threads at once.
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "profile.hpp"
+
+namespace sprof = shell::profile;
+
+namespace {
+
+constexpr int kIterations = 2000000;
+
+template <typename F>
+double NanosPerCall(int iterations, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f(i);
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         iterations;
+}
+
+// Nanoseconds per record() with `threads` threads recording at once.
+double ContendedRecord(int threads) {
+  sprof::Histogram histogram;
+  std::vector<std::thread> workers;
+  auto start = std::chrono::steady_clock::now();
+  for (int t = 0; t < threads; t++) {
+    workers.emplace_back([&histogram]() {
+      for (int i = 0; i < kIterations; i++) histogram.record(i & 0xffff);
+    });
+  }
+  for (auto& worker : workers) worker.join();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() /
+         kIterations;
+}
+
+}  // namespace
+
+int main() {
+  sprof::SetEnabled(false);
+  double off = NanosPerCall(kIterations, [](int) {
+    sprof::Scope scope{sprof::Phase::PARSE};
+  });
+  sprof::SetEnabled(true);
+  double on = NanosPerCall(kIterations, [](int) {
+    sprof::Scope scope{sprof::Phase::PARSE};
+  });
+  std::printf("%-24s %10s\n", "operation", "ns/call");
+  std::printf("%-24s %10.1f\n", "Scope, profiling off", off);
+  std::printf("%-24s %10.1f\n", "Scope, profiling on", on);
+  for (int threads : {1, 4}) {
+    char label[32];
+    std::snprintf(label, sizeof(label), "record, %d thread(s)", threads);
+    std::printf("%-24s %10.1f\n", label, ContendedRecord(threads));
+  }
+  return sprof::Get(sprof::Phase::PARSE).count() != kIterations;
+}
@@ -0,0 +1,102 @@
+// Resolves commands against a synthetic PATH of 20 directories with 5,000
+// files each, comparing the old directory-listing lookup with one faccessat
+// per directory (uncached, and through PathCache's open directory handles).
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "path_cache.hpp"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+namespace spc = shell::path_cache;
+
+namespace {
+
+constexpr int kDirs = 20;
+constexpr int kFilesPerDir = 5000;
+
+// GetCommandPath's inner loop before it switched to faccessat.
+std::string ListingFindInPathEntry(const std::string& loc,
+                                   const std::string& command) {
+  std::error_code loc_ec;
+  fs::file_status s = fs::status(fs::path(loc), loc_ec);
+  if (loc_ec || !fs::is_directory(s)) return "";
+  for (const auto& entry : fs::directory_iterator(loc)) {
+    if (command == entry.path().filename().string()) {
+      std::error_code file_ec;
+      fs::perms p = fs::status(entry, file_ec).permissions();
+      if (!file_ec && IsExecutable(p)) return entry.path().string();
+    }
+  }
+  return "";
+}
+
+template <typename F>
+double MicrosPerCall(int iterations, F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         iterations;
+}
+
+}  // namespace
+
+int main() {
+  fs::path root = fs::temp_directory_path() / "shell_bench_resolve";
+  fs::remove_all(root);
+  std::string path_env;
+  for (int d = 0; d < kDirs; d++) {
+    fs::path dir = root / ("bin" + std::to_string(d));
+    fs::create_directories(dir);
+    for (int f = 0; f < kFilesPerDir; f++) {
+      fs::path file = dir / ("cmd" + std::to_string(d) + "_" +
+                             std::to_string(f));
+      std::ofstream{file};
+      fs::permissions(file, fs::perms::owner_all);
+    }
+    path_env += (d == 0 ? "" : ":") + dir.string();
+  }
+  setenv("PATH", path_env.c_str(), 1);
+  std::vector<std::string> dirs = GetPathEntries();
+  // Found in the last directory, so every lookup walks all of PATH.
+  std::string command = "cmd" + std::to_string(kDirs - 1) + "_42";
+
+  auto listing = [&] {
+    for (const auto& dir : dirs) {
+      if (!ListingFindInPathEntry(dir, command).empty()) return;
+    }
+    std::abort();
+  };
+  auto stat_based = [&] {
+    for (const auto& dir : dirs) {
+      if (!FindInPathEntry(dir, command).empty()) return;
+    }
+    std::abort();
+  };
+  spc::PathCache cache{};
+  auto cached_miss = [&] {
+    cache.clear();
+    if (cache.lookup(command).empty()) std::abort();
+  };
+  auto cached_hit = [&] {
+    if (cache.lookup(command).empty()) std::abort();
+  };
+
+  std::printf("%-28s %12s\n", "resolver", "us/lookup");
+  std::printf("%-28s %12.1f\n", "directory listing",
+              MicrosPerCall(20, listing));
+  std::printf("%-28s %12.1f\n", "faccessat per entry",
+              MicrosPerCall(2000, stat_based));
+  std::printf("%-28s %12.1f\n", "PathCache miss (dir fds)",
+              MicrosPerCall(2000, cached_miss));
+  std::printf("%-28s %12.1f\n", "PathCache hit",
+              MicrosPerCall(2000, cached_hit));
+  fs::remove_all(root);
+  return 0;
+}
@@ -0,0 +1,70 @@
+// Measures how many commands per second the shell runs from a script file
+// and from a pipe on stdin, next to bash when it's installed. The script only
+// calls builtins, so the numbers reflect reading, parsing and dispatch rather
+// than program start-up.
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kLines = 100000;
+const char* kScript = "bench_script.sh";
+
+// Runs `argv` with stdout sent to /dev/null and stdin read from `input` (or
+// /dev/null), returning the elapsed seconds.
+double Run(const std::vector<std::string>& argv, const char* input) {
+  auto start = std::chrono::steady_clock::now();
+  pid_t pid = fork();
+  if (pid == 0) {
+    int in = open(input != nullptr ? input : "/dev/null", O_RDONLY);
+    int out = open("/dev/null", O_WRONLY);
+    dup2(in, STDIN_FILENO);
+    dup2(out, STDOUT_FILENO);
+    std::vector<char*> args;
+    for (const std::string& arg : argv) {
+      args.push_back(const_cast<char*>(arg.c_str()));
+    }
+    args.push_back(nullptr);
+    execvp(args[0], args.data());
+    _exit(127);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  auto end = std::chrono::steady_clock::now();
+  if (!WIFEXITED(status) || WEXITSTATUS(status) == 127) return -1;
+  return std::chrono::duration<double>(end - start).count();
+}
+
+void Report(const char* shell, const char* mode, double seconds) {
+  if (seconds < 0) {
+    std::printf("%-8s %-8s %14s\n", shell, mode, "failed");
+    return;
+  }
+  std::printf("%-8s %-8s %14.0f\n", shell, mode, kLines / seconds);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string shell = argc > 1 ? argv[1] : "./shell";
+  {
+    std::ofstream file{kScript};
+    for (int i = 0; i < kLines; i++) file << "echo line " << i << "\n";
+  }
+  std::printf("%-8s %-8s %14s\n", "shell", "mode", "commands_per_s");
+  Report("shell", "file", Run({shell, kScript}, nullptr));
+  Report("shell", "stdin", Run({shell}, kScript));
+  if (access("/bin/bash", X_OK) == 0) {
+    Report("bash", "file", Run({"/bin/bash", kScript}, nullptr));
+    Report("bash", "stdin", Run({"/bin/bash"}, kScript));
+  }
+  std::remove(kScript);
+  return 0;
+}
@@ -0,0 +1,73 @@
+// Compares starting an external command the way the shell used to (fork a
+// pipeline stage, then fork again to exec) against a single posix_spawn, while
+// the benchmark's resident set grows to mimic a long-lived shell.
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "launcher.hpp"
+
+namespace launch = shell::launcher;
+
+namespace {
+
+constexpr int kIterations = 200;
+const char* kProgram = "/bin/true";
+
+void DoubleFork() {
+  pid_t stage = fork();
+  if (stage == 0) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      execl(kProgram, "true", nullptr);
+      _exit(127);
+    }
+    waitpid(pid, NULL, 0);
+    _exit(0);
+  }
+  waitpid(stage, NULL, 0);
+}
+
+void SingleSpawn() {
+  launch::FileActions actions;
+  pid_t pid = launch::Spawn(kProgram, {"true"}, actions);
+  waitpid(pid, NULL, 0);
+}
+
+template <typename F>
+double MicrosPerCall(F f) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; i++) f();
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         kIterations;
+}
+
+}  // namespace
+
+int main() {
+  std::vector<char*> ballast;
+  size_t resident_mb = 0;
+  std::printf("%10s %16s %16s %8s\n", "rss_mb", "double_fork_us", "spawn_us",
+              "speedup");
+  for (size_t target_mb : {0, 64, 256, 1024}) {
+    while (resident_mb < target_mb) {
+      char* chunk = static_cast<char*>(std::malloc(1 << 20));
+      std::memset(chunk, 1, 1 << 20);
+      ballast.push_back(chunk);
+      resident_mb++;
+    }
+    double fork_us = MicrosPerCall(DoubleFork);
+    double spawn_us = MicrosPerCall(SingleSpawn);
+    std::printf("%10zu %16.1f %16.1f %7.1fx\n", resident_mb, fork_us, spawn_us,
+                fork_us / spawn_us);
+  }
+  for (char* chunk : ballast) std::free(chunk);
+  return 0;
+}
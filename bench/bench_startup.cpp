@@ -0,0 +1,112 @@
+// Measures how long PATH indexing keeps the prompt waiting. Compares the old
+// serial fill (fs::status on every entry, contains before each insert) with
+// PathIndexer, whose start() is all the prompt waits for now. With the path
+// to a built shell as argv[1], it also reports the real time from exec to the
+// first "$ " prompt.
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "launcher.hpp"
+#include "path_index.hpp"
+#include "trie.hpp"
+#include "utils.hpp"
+
+namespace fs = std::filesystem;
+namespace launch = shell::launcher;
+namespace spi = shell::path_index;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double MillisSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// FillTrieWithPathExecutables before indexing moved off the main thread.
+void SerialFill(Trie* trie, const std::vector<std::string>& dirs) {
+  for (const auto& loc : dirs) {
+    std::error_code loc_ec;
+    fs::file_status s = fs::status(fs::path(loc), loc_ec);
+    if (loc_ec || !fs::is_directory(s)) continue;
+    for (const auto& entry : fs::directory_iterator(loc)) {
+      std::string filename = entry.path().filename().string();
+      std::error_code file_ec;
+      fs::perms p = fs::status(entry, file_ec).permissions();
+      if (!file_ec && IsExecutable(p) && !trie->contains(filename)) {
+        trie->insert(filename);
+      }
+    }
+  }
+}
+
+double TimeToFirstPrompt(const std::string& shell) {
+  int in_pipe[2];
+  int out_pipe[2];
+  pipe2(in_pipe, O_CLOEXEC);
+  pipe2(out_pipe, O_CLOEXEC);
+  launch::FileActions actions;
+  actions.dup2(in_pipe[0], STDIN_FILENO);
+  actions.dup2(out_pipe[1], STDOUT_FILENO);
+  auto start = Clock::now();
+  pid_t pid = launch::Spawn(shell, {"shell"}, actions);
+  close(in_pipe[0]);
+  close(out_pipe[1]);
+  std::string seen;
+  char c;
+  while (seen.find("$ ") == std::string::npos &&
+         read(out_pipe[0], &c, 1) == 1) {
+    seen += c;
+  }
+  double ms = MillisSince(start);
+  write(in_pipe[1], "exit\n", 5);
+  close(in_pipe[1]);
+  close(out_pipe[0]);
+  waitpid(pid, NULL, 0);
+  return ms;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> dirs = GetPathEntries();
+
+  auto start = Clock::now();
+  {
+    Trie trie = Trie{};
+    SerialFill(&trie, dirs);
+  }
+  double serial_ms = MillisSince(start);
+
+  start = Clock::now();
+  double blocked_ms;
+  size_t indexed;
+  {
+    Trie trie = Trie{};
+    spi::PathIndexer indexer{};
+    indexer.start(&trie, dirs);
+    blocked_ms = MillisSince(start);
+    indexer.wait();
+    indexed = indexer.indexed();
+  }
+  double parallel_ms = MillisSince(start);
+
+  std::printf("PATH entries: %zu, executables: %zu\n", dirs.size(), indexed);
+  std::printf("%-34s %10s\n", "indexer", "ms");
+  std::printf("%-34s %10.2f\n", "serial fill (blocks prompt)", serial_ms);
+  std::printf("%-34s %10.2f\n", "parallel, prompt blocked for", blocked_ms);
+  std::printf("%-34s %10.2f\n", "parallel, until fully indexed", parallel_ms);
+  if (argc > 1) {
+    std::printf("%-34s %10.2f\n", "shell exec to first prompt",
+                TimeToFirstPrompt(argv[1]));
+  }
+  return 0;
+}
@@ -0,0 +1,100 @@
+// Compares the radix Trie with the old pointer-per-character trie on the
+// executables in PATH plus synthetic names: heap used, build time and
+// prefix-query latency.
+#include <dirent.h>
+#include <malloc.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "legacy_trie.hpp"
+#include "trie.hpp"
+#include "utils.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+constexpr size_t kSyntheticWords = 50000;
+
+std::vector<std::string> Words() {
+  std::set<std::string> words;
+  for (const auto& loc : GetPathEntries()) {
+    DIR* dir = opendir(loc.c_str());
+    if (dir == nullptr) continue;
+    while (dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.') words.insert(entry->d_name);
+    }
+    closedir(dir);
+  }
+  // Tool-like names sharing prefixes, e.g., "git-credential-3f".
+  std::mt19937 rng(7);
+  const char* stems[] = {"git-", "x86_64-linux-gnu-", "python3.", "lib",
+                         "systemd-", "k", "docker-", "py"};
+  while (words.size() < kSyntheticWords) {
+    std::string word = stems[rng() % 8];
+    for (int i = 4 + rng() % 10; i > 0; i--) word += 'a' + rng() % 26;
+    words.insert(word);
+  }
+  std::vector<std::string> res(words.begin(), words.end());
+  std::shuffle(res.begin(), res.end(), rng);
+  return res;
+}
+
+size_t HeapInUse() { return mallinfo2().uordblks; }
+
+template <typename T>
+void Run(const char* name, const std::vector<std::string>& words,
+         const std::vector<std::string>& prefixes) {
+  size_t heap_before = HeapInUse();
+  auto start = Clock::now();
+  auto* trie = new T{};
+  for (const auto& word : words) trie->insert(word);
+  double build_ms =
+      std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+  size_t heap = HeapInUse() - heap_before;
+
+  size_t matches = 0;
+  start = Clock::now();
+  for (int round = 0; round < 20; round++) {
+    for (const auto& prefix : prefixes) {
+      matches += trie->getWords(prefix).size();
+    }
+  }
+  double query_us =
+      std::chrono::duration<double, std::micro>(Clock::now() - start).count() /
+      (20 * prefixes.size());
+
+  start = Clock::now();
+  size_t found = 0;
+  for (const auto& word : words) found += trie->contains(word);
+  if (found != words.size()) std::abort();
+  double contains_ns =
+      std::chrono::duration<double, std::nano>(Clock::now() - start).count() /
+      words.size();
+  delete trie;
+
+  std::printf("%-8s %10.2f %10.1f %14.1f %14.1f %9zu\n", name,
+              heap / (1024.0 * 1024.0), build_ms, query_us, contains_ns,
+              matches / 20);
+}
+
+}  // namespace
+
+int main() {
+  auto words = Words();
+  std::vector<std::string> prefixes = {"g",    "gi",  "git-", "py",  "python3.",
+                                       "x86_", "l",   "lib",  "sy",  "k",
+                                       "ls",   "do",  "z",    "ca",  "tar"};
+  std::printf("%zu words, %zu prefixes\n", words.size(), prefixes.size());
+  std::printf("%-8s %10s %10s %14s %14s %9s\n", "trie", "heap_mb", "build_ms",
+              "prefix_us", "contains_ns", "matches");
+  Run<LegacyTrie>("legacy", words, prefixes);
+  Run<Trie>("radix", words, prefixes);
+  return 0;
+}
@@ -0,0 +1,91 @@
+// The pointer-per-character Trie the shell used before the radix tree, kept
+// as a baseline for bench_trie.
+#ifndef BENCH_LEGACY_TRIE_H_
+#define BENCH_LEGACY_TRIE_H_
+
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct LegacyTrieNode {
+  const char letter;
+  std::unordered_map<char, LegacyTrieNode*> children;
+  bool isEndOfWord;
+
+  explicit LegacyTrieNode(char letter) : letter(letter), isEndOfWord(false) {}
+};
+
+class LegacyTrie {
+ private:
+  LegacyTrieNode* root;
+  void deleteTrieNode(LegacyTrieNode* node) {
+    if (node == nullptr) return;
+    for (auto& child : node->children) {
+      this->deleteTrieNode(child.second);
+    }
+    delete node;
+  }
+
+ public:
+  LegacyTrie() : root(new LegacyTrieNode('\0')) {}
+  ~LegacyTrie() { this->deleteTrieNode(this->root); }
+
+  void insert(const std::string& word) {
+    LegacyTrieNode* curr = this->root;
+    for (char c : word) {
+      auto& map = curr->children;
+      if (map.find(c) != map.end()) {
+        curr = map[c];
+      } else {
+        LegacyTrieNode* node = new LegacyTrieNode{c};
+        map[c] = node;
+        curr = node;
+      }
+    }
+    curr->isEndOfWord = true;
+  }
+
+  bool contains(const std::string& word) {
+    LegacyTrieNode* curr = this->root;
+    for (char c : word) {
+      auto& map = curr->children;
+      if (map.find(c) != map.end()) {
+        curr = map[c];
+      } else {
+        return false;
+      }
+    }
+    return curr->isEndOfWord;
+  }
+
+  std::vector<std::string> getWords(const std::string& prefix) {
+    std::vector<std::string> words;
+    LegacyTrieNode* curr = this->root;
+    for (auto c : prefix) {
+      if (curr->children.find(c) != curr->children.end()) {
+        curr = curr->children[c];
+      } else {
+        return words;
+      }
+    }
+    std::queue<std::pair<LegacyTrieNode*, std::string>> queue;
+    if (curr != this->root) {
+      queue.emplace(curr, prefix);
+    }
+    while (!queue.empty()) {
+      auto [node, word] = queue.front();
+      queue.pop();
+      if (node->isEndOfWord) {
+        words.push_back(word);
+      }
+      for (auto& child : node->children) {
+        queue.emplace(child.second, word + child.first);
+      }
+    }
+    return words;
+  }
+};
+
+#endif  // BENCH_LEGACY_TRIE_H_
@@ -0,0 +1,54 @@
+#ifndef SRC_ARENA_CPP_
+#define SRC_ARENA_CPP_
+
+#include "./arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string_view>
+
+namespace sarena = shell::arena;
+
+sarena::Arena::Arena(size_t block_size)
+    : block_size(block_size), next(nullptr), left(0), bytes(0) {}
+
+void* sarena::Arena::allocate(size_t bytes, size_t alignment) {
+  size_t padding = -reinterpret_cast<uintptr_t>(this->next) & (alignment - 1);
+  if (this->next == nullptr || padding + bytes > this->left) {
+    // Oversized requests get a block of their own.
+    size_t size = std::max(this->block_size, bytes + alignment);
+    this->blocks.push_back(std::make_unique<std::byte[]>(size));
+    this->next = this->blocks.back().get();
+    this->left = size;
+    padding = -reinterpret_cast<uintptr_t>(this->next) & (alignment - 1);
+  }
+  std::byte* res = this->next + padding;
+  this->next = res + bytes;
+  this->left -= padding + bytes;
+  this->bytes += bytes;
+  return res;
+}
+
+std::string_view sarena::Arena::copy(std::string_view txt) {
+  if (txt.empty()) return {};
+  char* data = static_cast<char*>(this->allocate(txt.size(), 1));
+  std::memcpy(data, txt.data(), txt.size());
+  return {data, txt.size()};
+}
+
+void sarena::Arena::reset() {
+  if (this->blocks.size() > 1) {
+    this->blocks.resize(1);
+  }
+  this->next = this->blocks.empty() ? nullptr : this->blocks[0].get();
+  // The first block may have been an oversized one.
+  this->left = this->blocks.empty() ? 0 : this->block_size;
+  this->bytes = 0;
+}
+
+size_t sarena::Arena::used() const { return this->bytes; }
+
+#endif  // SRC_ARENA_CPP_
@@ -0,0 +1,51 @@
+#ifndef SRC_ARENA_H_
+#define SRC_ARENA_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <span>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace shell::arena {
+
+constexpr size_t kBlockSize = 4096;
+
+// Bump allocator handing out memory from a list of blocks that are only
+// released all at once, when the arena is reset or destroyed. Objects placed
+// in it are never destroyed, so it only holds trivially destructible types.
+class Arena {
+ public:
+  explicit Arena(size_t block_size = kBlockSize);
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  void* allocate(size_t bytes, size_t alignment);
+  // Copies `items` into the arena.
+  template <typename T>
+  std::span<const T> copy(std::span<const T> items) {
+    static_assert(std::is_trivially_destructible_v<T>);
+    if (items.empty()) return {};
+    T* data = static_cast<T*>(
+        this->allocate(sizeof(T) * items.size(), alignof(T)));
+    std::uninitialized_copy(items.begin(), items.end(), data);
+    return {data, items.size()};
+  }
+  std::string_view copy(std::string_view txt);
+  // Releases everything but the first block, which is reused.
+  void reset();
+  // Bytes handed out since construction or the last reset.
+  size_t used() const;
+
+ private:
+  size_t block_size;
+  std::vector<std::unique_ptr<std::byte[]>> blocks;
+  std::byte* next;
+  size_t left;
+  size_t bytes;
+};
+
+}  // namespace shell::arena
+
+#endif  // SRC_ARENA_H_
@@ -3,156 +3,567 @@
 
 #include "./history.hpp"
 
+#include <fcntl.h>
 #include <readline/readline.h>
 #include <spdlog/spdlog.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
 #include <filesystem>
-#include <fstream>
+#include <span>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "./io.hpp"
+
 namespace hist = shell::history;
 namespace fs = std::filesystem;
+namespace sio = shell::io;
+
+namespace {
+// Only compact once there's enough garbage to be worth the copy.
+constexpr size_t kMinCompactBytes = 4096;
 
-hist::Node::Node(const std::string& txt)
-    : txt(txt), next(nullptr), prior(nullptr) {}
+struct Record {
+  std::string_view text;
+  int64_t time;
+  uint32_t session;
+};
 
-hist::History::History() : size(0), max_size(100) { this->initalize(); }
-hist::History::History(size_t max_size) : size(0), max_size(max_size) {
-  this->initalize();
+// Parses a `#<time>[:<session>]` line preceding a record.
+bool ParseStamp(std::string_view line, int64_t* time, uint32_t* session) {
+  if (line.size() < 2 || line[0] != '#' || !isdigit(line[1])) return false;
+  const char* end = line.data() + line.size();
+  auto [p, ec] = std::from_chars(line.data() + 1, end, *time);
+  *session = 0;
+  if (p != end && *p == ':') {
+    std::from_chars(p + 1, end, *session);
+  }
+  return true;
+}
+
+// The last `max` non-empty records of `data`, newest first.
+std::vector<Record> LastRecords(std::string_view data, size_t max) {
+  std::vector<Record> records;
+  // Index of the record the line being looked at would stamp, if any.
+  size_t unstamped = std::string_view::npos;
+  const char* begin = data.data();
+  const char* end = begin + data.size();
+  while (end > begin) {
+    auto* nl = static_cast<const char*>(memrchr(begin, '\n', end - begin));
+    const char* start = nl == nullptr ? begin : nl + 1;
+    std::string_view line(start, end - start);
+    int64_t time;
+    uint32_t session;
+    if (ParseStamp(line, &time, &session)) {
+      if (unstamped != std::string_view::npos) {
+        records[unstamped].time = time;
+        records[unstamped].session = session;
+      }
+      unstamped = std::string_view::npos;
+    } else if (records.size() == max) {
+      break;
+    } else if (!line.empty()) {
+      records.push_back(Record{line, 0, 0});
+      unstamped = records.size() - 1;
+    } else {
+      unstamped = std::string_view::npos;
+    }
+    if (nl == nullptr) break;
+    end = nl;
+  }
+  return records;
 }
-void hist::History::initalize() {
-  Node* node = new hist::Node{""};
-  this->head = node;
-  this->tail = node;
-  this->current = node;
-  this->last_written = nullptr;
+
+std::string Canonical(const std::string& filename) {
+  std::error_code ec;
+  fs::path path = fs::weakly_canonical(fs::absolute(filename), ec);
+  return ec ? filename : path.string();
+}
+}  // namespace
+
+hist::History::History() : History(100) {}
+hist::History::History(size_t max_size)
+    : size(0),
+      max_size(max_size),
+      timestamps(false),
+      dead_bytes(0),
+      entries(max_size),
+      oldest(0),
+      current(0),
+      first_seq(0),
+      unwritten_seq(0),
+      session(getpid()),
+      file_fd(-1),
+      persisted_seq(0),
+      read_offset(0),
+      pruned_seq(0) {}
+
+hist::History::~History() {
+  if (this->file_fd != -1) close(this->file_fd);
+}
+
+hist::History::Span& hist::History::span(size_t i) {
+  return this->entries[(this->oldest + i) % this->max_size];
 }
-hist::History::~History() { this->deleteNode(this->head); }
 
-void hist::History::deleteNode(Node* node) {
-  if (node == nullptr) return;
-  this->deleteNode(node->next);
-  delete node;
+std::string_view hist::History::operator[](size_t i) const {
+  const Span& s = this->entries[(this->oldest + i) % this->max_size];
+  return std::string_view(this->arena).substr(s.offset, s.len);
 }
 
-void hist::History::deleteTail() {
-  Node* node = this->tail;
-  if (node == this->head) return;
-  spdlog::debug("Deleting tail node with text \"{}\".", node->txt);
-  if (this->last_written == this->tail) {
-    this->last_written = node->prior;
+int64_t hist::History::timestamp(size_t i) const {
+  return this->entries[(this->oldest + i) % this->max_size].time;
+}
+
+hist::History::Span hist::History::store(std::string_view txt) {
+  if (this->dead_bytes > kMinCompactBytes &&
+      this->dead_bytes * 2 > this->arena.size()) {
+    this->compact();
+  }
+  Span s{static_cast<uint32_t>(this->arena.size()),
+         static_cast<uint32_t>(txt.size()), 0, 0};
+  this->arena.append(txt);
+  return s;
+}
+
+void hist::History::release(const Span& s) { this->dead_bytes += s.len; }
+
+void hist::History::compact() {
+  SPDLOG_DEBUG("Compacting history arena, {} of {} bytes dead.",
+                this->dead_bytes, this->arena.size());
+  std::string compacted;
+  compacted.reserve(this->arena.size() - this->dead_bytes);
+  for (size_t i = 0; i < this->size; i++) {
+    Span& s = this->span(i);
+    uint32_t offset = compacted.size();
+    compacted.append(this->arena, s.offset, s.len);
+    s.offset = offset;
   }
-  this->tail = node->prior;
-  this->tail->next = nullptr;
-  delete node;
-  this->size--;
+  this->arena.swap(compacted);
+  this->dead_bytes = 0;
 }
 
 void hist::History::insert(const std::string& txt) {
-  this->current = this->head;
-  Node* node = new hist::Node{txt};
-  if (this->head == this->tail) {
-    this->tail = node;
-  }
-  // Begin at head->next to ensure init node containing user text remains at the
-  // front.
-  Node* old_head = this->head->next;
-  if (old_head != nullptr) {
-    old_head->prior = node;
-  }
-  node->next = old_head;
-  node->prior = this->head;
-  this->head->next = node;
+  this->current = 0;
+  this->push(txt, std::time(nullptr), this->session);
+}
+
+void hist::History::push(std::string_view txt, int64_t time,
+                         uint32_t session) {
+  if (this->max_size == 0) return;
+  if (this->size == this->max_size) {
+    SPDLOG_DEBUG("Evicting oldest entry \"{}\".", (*this)[0]);
+    this->release(this->span(0));
+    this->oldest = (this->oldest + 1) % this->max_size;
+    this->first_seq++;
+    this->size--;
+    // Pruning once the whole ring has turned over keeps it amortized O(1).
+    if (this->first_seq - this->pruned_seq >= this->max_size) {
+      this->index.prune(this->first_seq);
+      this->pruned_seq = this->first_seq;
+    }
+  }
+  this->index.add(this->first_seq + this->size, txt);
+  Span s = this->store(txt);
+  s.time = time;
+  s.session = session;
+  this->span(this->size) = s;
   this->size++;
-  if (this->size > this->max_size) {
-    this->deleteTail();
+}
+
+size_t hist::History::search(std::string_view query, size_t before) const {
+  before = std::min(before, this->size);
+  if (query.empty()) return this->size;
+  if (query.size() < kGramSize) {
+    for (size_t i = before; i-- > 0;) {
+      if ((*this)[i].find(query) != std::string_view::npos) return i;
+    }
+    return this->size;
+  }
+  const auto* candidates = this->index.candidates(query);
+  if (candidates == nullptr) return this->size;
+  auto it = std::lower_bound(candidates->begin(), candidates->end(),
+                             this->first_seq + before);
+  while (it != candidates->begin()) {
+    it--;
+    if (*it < this->first_seq) break;
+    // Edits made while browsing aren't indexed, so check the text itself.
+    size_t i = *it - this->first_seq;
+    if ((*this)[i].find(query) != std::string_view::npos) return i;
   }
-  spdlog::debug("New head text is \"{}\".", this->head->next->txt);
+  return this->size;
+}
+
+hist::History::Iterator::Iterator() : history(nullptr), index(0) {}
+
+hist::History::Iterator::Iterator(const History* history, size_t index)
+    : history(history), index(index) {}
+
+std::string_view hist::History::Iterator::operator*() const {
+  return (*this->history)[this->index];
+}
+
+hist::History::Iterator& hist::History::Iterator::operator++() {
+  this->index++;
+  return *this;
+}
+
+hist::History::Iterator hist::History::Iterator::operator++(int) {
+  Iterator prev = *this;
+  this->index++;
+  return prev;
+}
+
+bool hist::History::Iterator::operator==(const Iterator& other) const {
+  return this->index == other.index;
+}
+
+bool hist::History::Iterator::operator!=(const Iterator& other) const {
+  return !(*this == other);
+}
+
+hist::History::Iterator hist::History::begin() const {
+  return Iterator(this, 0);
+}
+
+hist::History::Iterator hist::History::end() const {
+  return Iterator(this, this->size);
 }
 
 std::vector<std::string> hist::History::get() {
   std::vector<std::string> res;
-  // Skip past inital node that represents current user input.
-  Node* n = this->head->next;
-  while (n != nullptr) {
-    spdlog::debug("Reading node with text \"{}\".", n->txt);
-    res.push_back(n->txt);
-    n = n->next;
+  res.reserve(this->size);
+  for (size_t i = this->size; i > 0; i--) {
+    res.emplace_back((*this)[i - 1]);
   }
   return res;
 }
 
 std::vector<std::string> hist::History::getReverse() {
-  std::vector<std::string> res;
-  Node* n = this->tail;
-  while (n != this->head) {
-    spdlog::debug("Reading node with text \"{}\".", n->txt);
-    res.push_back(n->txt);
-    n = n->prior;
-  }
-  return res;
+  return std::vector<std::string>(this->begin(), this->end());
 }
 
 hist::History* hist::GLOBAL_HISTORY = nullptr;
-std::vector<std::string> hist::GetHistory() {
+const hist::History& hist::GetHistory() {
   if (GLOBAL_HISTORY == nullptr) {
     throw std::runtime_error("Must configure `GLOBAL_HISTORY` variable.");
   }
-  return GLOBAL_HISTORY->getReverse();
+  return *GLOBAL_HISTORY;
+}
+
+int hist::HistoryCommand(std::span<const std::string_view> args,
+                         sio::OutputSink* out) {
+  const auto& history = GetHistory();
+  size_t count = history.size;
+  auto file = [&args](size_t i) {
+    if (i >= args.size()) {
+      throw std::runtime_error("history: " + std::string(args[i - 1]) +
+                               ": option requires an argument");
+    }
+    return std::string(args[i]);
+  };
+  for (size_t i = 0; i < args.size(); i++) {
+    if (args[i] == "-r") {
+      GLOBAL_HISTORY->load(file(++i));
+      return 0;
+    } else if (args[i] == "-w") {
+      GLOBAL_HISTORY->save(file(++i), std::ios_base::out);
+      return 0;
+    } else if (args[i] == "-a") {
+      GLOBAL_HISTORY->save(file(++i), std::ios_base::app);
+      return 0;
+    } else if (args[i] == "-n") {
+      GLOBAL_HISTORY->merge();
+      return 0;
+    } else {
+      int n = std::stoi(std::string(args[i]));
+      if (n < 0) {
+        throw std::runtime_error("invalid option.");
+      }
+      count = n;
+    }
+  }
+  const char* time_format = getenv("HISTTIMEFORMAT");
+  // "    <number>  <stamp>" goes into a small buffer; the entry itself is
+  // passed to the sink by reference.
+  char prefix[160] = "    ";
+  for (size_t i = history.size - std::min(count, history.size);
+       i < history.size; i++) {
+    char* end = std::to_chars(prefix + 4, prefix + 32, i + 1).ptr;
+    *end++ = ' ';
+    *end++ = ' ';
+    time_t time = history.timestamp(i);
+    if (time_format != NULL && time != 0) {
+      struct tm tm;
+      localtime_r(&time, &tm);
+      end += strftime(end, prefix + sizeof(prefix) - end, time_format, &tm);
+    }
+    out->write(std::string_view(prefix, end - prefix));
+    out->writeRef(history[i]);
+    out->write("\n");
+  }
+  return 0;
 }
 
 void hist::History::incrementCurrent() {
-  if (this->current->next != nullptr) {
-    this->current = this->current->next;
+  if (this->current < this->size) {
+    this->current++;
   }
 }
 void hist::History::decrementCurrent() {
-  if (this->current->prior != nullptr) {
-    this->current = this->current->prior;
+  if (this->current > 0) {
+    this->current--;
   }
 }
 
-std::string hist::History::getCurrentTxt() { return this->current->txt; }
+std::string hist::History::getCurrentTxt() {
+  if (this->current == 0) {
+    return this->scratch;
+  }
+  return std::string((*this)[this->size - this->current]);
+}
 
 void hist::History::setCurrentTxt(const std::string& txt) {
-  this->current->txt = txt;
+  if (this->current == 0) {
+    this->scratch = txt;
+    return;
+  }
+  size_t i = this->size - this->current;
+  uint32_t old_len = this->span(i).len;
+  Span s = this->store(txt);
+  this->span(i).offset = s.offset;
+  this->span(i).len = s.len;
+  this->dead_bytes += old_len;
+}
+
+std::string hist::History::since(uint64_t seq) const {
+  std::string res;
+  size_t i = seq > this->first_seq ? seq - this->first_seq : 0;
+  for (; i < this->size; i++) {
+    const Span& s = this->entries[(this->oldest + i) % this->max_size];
+    if (this->timestamps && s.time != 0) {
+      res += '#' + std::to_string(s.time) + ':' + std::to_string(s.session) +
+             '\n';
+    }
+    res.append((*this)[i]);
+    res += '\n';
+  }
+  return res;
+}
+
+size_t hist::History::pushRecords(std::string_view data, uint64_t offset) {
+  size_t count = 0;
+  bool stamped = false;
+  int64_t time = 0;
+  uint32_t session = 0;
+  auto own = this->own_writes.begin();
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t nl = data.find('\n', pos);
+    if (nl == std::string_view::npos) nl = data.size();
+    uint64_t at = offset + pos;
+    std::string_view line = data.substr(pos, nl - pos);
+    pos = nl + 1;
+    while (own != this->own_writes.end() && own->first + own->second <= at) {
+      own++;
+    }
+    if (own != this->own_writes.end() && at >= own->first) {
+      stamped = false;
+      continue;
+    }
+    if (ParseStamp(line, &time, &session)) {
+      stamped = true;
+      continue;
+    }
+    if (!line.empty()) {
+      this->push(line, stamped ? time : 0, stamped ? session : 0);
+      count++;
+    }
+    stamped = false;
+  }
+  return count;
 }
 
 void hist::History::save(const std::string& filename,
                          std::ios_base::openmode open_mode) {
+  bool attached = !this->file_path.empty() &&
+                  Canonical(filename) == this->file_path;
+  if (attached && open_mode == std::ios_base::app) {
+    // The session file only lacks what `persist` hasn't written yet.
+    this->persist();
+    this->unwritten_seq = this->first_seq + this->size;
+    return;
+  }
   if (open_mode == std::ios_base::out) {
-    this->last_written = nullptr;
+    this->unwritten_seq = this->first_seq;
+  }
+  int flags = O_WRONLY | O_CREAT | O_CLOEXEC |
+              (open_mode == std::ios_base::app ? O_APPEND : 0);
+  int fd = open(filename.c_str(), flags, 0644);
+  if (fd == -1) {
+    throw std::runtime_error("cannot write history to " + filename);
+  }
+  // Truncate only once other sessions are done with the file.
+  flock(fd, LOCK_EX);
+  try {
+    if (open_mode != std::ios_base::app && ftruncate(fd, 0) == -1) {
+      throw std::runtime_error("cannot truncate " + filename);
+    }
+    sio::WriteAll(fd, this->since(this->unwritten_seq));
+  } catch (...) {
+    close(fd);
+    throw;
+  }
+  struct stat st;
+  if (attached && fstat(fd, &st) == 0) {
+    this->read_offset = st.st_size;
+    this->own_writes.clear();
   }
-  std::ofstream write_file;
-  fs::path file_path{filename};
-  write_file.open(file_path, open_mode);
-  Node* curr =
-      this->last_written == nullptr ? this->tail : this->last_written->prior;
-  while (curr != this->head) {
-    write_file << curr->txt << '\n';
-    curr = curr->prior;
+  close(fd);
+  this->unwritten_seq = this->first_seq + this->size;
+  if (attached) {
+    this->persisted_seq = this->unwritten_seq;
   }
-  this->last_written = this->head->next;
-  write_file.close();
 }
 
 void hist::History::load(const std::string& filename) {
-  std::ifstream read_file;
-  fs::path file_path{filename};
-  read_file.open(file_path);
-  if (!read_file) return;
-  std::string line;
-  while (std::getline(read_file, line)) {
-    if (!line.empty()) {
-      this->insert(line);
+  this->loadFile(filename);
+}
+
+uint64_t hist::History::loadFile(const std::string& filename) {
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return 0;
+  flock(fd, LOCK_SH);
+  struct stat s;
+  if (fstat(fd, &s) == -1 || s.st_size == 0) {
+    close(fd);
+    return 0;
+  }
+  void* data = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    SPDLOG_DEBUG("Couldn't map history file {}.", filename);
+    return 0;
+  }
+  auto records = LastRecords(
+      std::string_view(static_cast<const char*>(data), s.st_size),
+      this->max_size);
+  size_t bytes = 0;
+  for (const auto& record : records) {
+    bytes += record.text.size();
+  }
+  this->arena.reserve(this->arena.size() + bytes);
+  for (auto it = records.rbegin(); it != records.rend(); it++) {
+    this->push(it->text, it->time, it->session);
+  }
+  munmap(data, s.st_size);
+  this->current = 0;
+  this->unwritten_seq = this->first_seq + this->size;
+  this->persisted_seq = this->unwritten_seq;
+  return s.st_size;
+}
+
+void hist::History::attach(const std::string& filename) {
+  this->read_offset = this->loadFile(filename);
+  this->own_writes.clear();
+  if (this->file_fd != -1) close(this->file_fd);
+  this->file_fd = -1;
+  this->file_path = Canonical(filename);
+}
+
+void hist::History::persist() {
+  if (this->file_path.empty()) return;
+  std::string pending = this->since(this->persisted_seq);
+  this->persisted_seq = this->first_seq + this->size;
+  if (pending.empty()) return;
+  if (this->file_fd == -1) {
+    this->file_fd = open(this->file_path.c_str(),
+                         O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (this->file_fd == -1) {
+      perror("history");
+      return;
+    }
+  }
+  // Holding the lock keeps other sessions' records from landing in between,
+  // and tells us where ours starts.
+  flock(this->file_fd, LOCK_EX);
+  struct stat st;
+  uint64_t start = fstat(this->file_fd, &st) == 0 ? st.st_size : 0;
+  try {
+    sio::WriteAll(this->file_fd, pending);
+    if (start == this->read_offset) {
+      this->read_offset += pending.size();
+    } else {
+      this->own_writes.emplace_back(start, pending.size());
     }
+  } catch (const std::exception& e) {
+    spdlog::warn("Couldn't append to {}: {}.", this->file_path, e.what());
   }
-  this->last_written = this->head->next;
-  read_file.close();
+  flock(this->file_fd, LOCK_UN);
 }
 
-int hist::ArrowHistory(int count, int key) {
+size_t hist::History::merge() {
+  if (this->file_path.empty()) return 0;
+  this->persist();
+  int fd = open(this->file_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) return 0;
+  flock(fd, LOCK_SH);
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    return 0;
+  }
+  uint64_t size = st.st_size;
+  if (size < this->read_offset) {
+    // Someone rewrote the file (e.g., `history -w`); start over.
+    SPDLOG_DEBUG("{} shrank, merging it from the start.", this->file_path);
+    this->read_offset = 0;
+    this->own_writes.clear();
+  }
+  std::string data(size - this->read_offset, '\0');
+  size_t got = 0;
+  while (got < data.size()) {
+    ssize_t bytes = pread(fd, data.data() + got, data.size() - got,
+                          this->read_offset + got);
+    if (bytes < 0 && errno == EINTR) continue;
+    if (bytes <= 0) break;
+    got += bytes;
+  }
+  close(fd);
+  // Only whole lines, a writer that doesn't lock may be mid-record.
+  data.resize(got);
+  size_t last = data.rfind('\n');
+  data.resize(last == std::string::npos ? 0 : last + 1);
+  if (data.empty()) return 0;
+  bool synced = this->unwritten_seq >= this->first_seq + this->size;
+  size_t count = this->pushRecords(data, this->read_offset);
+  this->read_offset += data.size();
+  std::erase_if(this->own_writes, [this](const auto& write) {
+    return write.first < this->read_offset;
+  });
+  // What came from the file needn't be written back.
+  this->persisted_seq = this->first_seq + this->size;
+  if (synced) {
+    this->unwritten_seq = this->persisted_seq;
+  }
+  this->current = 0;
+  return count;
+}
+
+int hist::ArrowHistory(int, int key) {
   char* og_text = rl_copy_text(0, rl_end);
   std::string text_copy{og_text};
   free(og_text);
@@ -170,4 +581,61 @@ int hist::ArrowHistory(int count, int key) {
   return 0;
 }
 
+int hist::ReverseSearch(int, int) {
+  constexpr int kCtrlG = 7;
+  constexpr int kCtrlR = 18;
+  constexpr int kBackspace = 8;
+  constexpr int kDelete = 127;
+  const History& history = *hist::GLOBAL_HISTORY;
+  char* og_text = rl_copy_text(0, rl_end);
+  std::string original{og_text};
+  free(og_text);
+  std::string query;
+  size_t match = history.size;
+  bool failed = false;
+  std::string prompt = rl_prompt == nullptr ? "" : rl_prompt;
+  while (true) {
+    std::string line =
+        match < history.size ? std::string(history[match]) : original;
+    std::string search_prompt = std::string("(") + (failed ? "failed " : "") +
+                                "reverse-i-search)`" + query + "': ";
+    rl_set_prompt(search_prompt.c_str());
+    rl_replace_line(line.c_str(), 0);
+    size_t at = match < history.size ? line.find(query) : std::string::npos;
+    rl_point = at == std::string::npos ? rl_end : at;
+    rl_redisplay();
+    int c = rl_read_key();
+    if (c == kCtrlR) {
+      size_t found = history.search(query, match);
+      failed = found == history.size;
+      if (!failed) match = found;
+    } else if (c == kBackspace || c == kDelete) {
+      if (!query.empty()) query.pop_back();
+      match = history.search(query, history.size);
+      failed = false;
+    } else if (c == kCtrlG || c <= 0) {
+      // Aborted, or the terminal went away (rl_read_key gives EOF or 0).
+      rl_set_prompt(prompt.c_str());
+      rl_replace_line(original.c_str(), 0);
+      rl_point = rl_end;
+      rl_redisplay();
+      return 0;
+    } else if (c >= ' ' && c < kDelete) {
+      query += static_cast<char>(c);
+      // The current match stays if it still matches.
+      size_t from = match < history.size ? match + 1 : history.size;
+      size_t found = history.search(query, from);
+      failed = found == history.size;
+      if (!failed) match = found;
+    } else {
+      // Any other key accepts the match and then does its usual job.
+      rl_set_prompt(prompt.c_str());
+      rl_point = rl_end;
+      rl_redisplay();
+      rl_execute_next(c);
+      return 0;
+    }
+  }
+}
+
 #endif  // SRC_HISTORY_CPP_
@@ -1,51 +1,169 @@
 #ifndef SRC_HISTORY_H_
 #define SRC_HISTORY_H_
 
+#include <cstdint>
 #include <filesystem>
+#include <iterator>
+#include <span>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-namespace shell::history {
-
-struct Node {
-  std::string txt;
-  Node* prior;
-  Node* next;
+#include "./history_index.hpp"
+#include "./io.hpp"
 
-  explicit Node(const std::string& txt);
-};
+namespace shell::history {
 
+// Command history kept in a fixed-capacity ring buffer. Entry texts live back
+// to back in a single arena that is compacted once most of it is dead, so
+// inserting, evicting the oldest entry and indexed access are all O(1)
+// (amortized) and reading the history never copies it.
+//
+// Besides the entries there's a scratch slot holding the line the user is
+// currently editing; `current` walks from it through older entries with
+// `incrementCurrent` and back with `decrementCurrent`.
+//
+// Several shells may share the attached history file. Every append is a
+// single write made under an exclusive flock(2), so records never interleave,
+// and `merge` picks up what other sessions appended since it last looked.
+// When `timestamps` is set, each record is preceded by a `#<time>:<session>`
+// line, which bash also reads as the entry's timestamp.
 class History {
  public:
   size_t size;
   size_t max_size;
+  // Whether saved records carry a timestamp and session line.
+  bool timestamps;
+
+  // Iterates over entries from oldest to newest without copying them.
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = std::string_view;
+    Iterator();
+    Iterator(const History* history, size_t index);
+    std::string_view operator*() const;
+    Iterator& operator++();
+    Iterator operator++(int);
+    bool operator==(const Iterator& other) const;
+    bool operator!=(const Iterator& other) const;
+
+   private:
+    const History* history;
+    size_t index;
+  };
+
   void insert(const std::string& txt);
   void incrementCurrent();
   void decrementCurrent();
   void setCurrentTxt(const std::string& txt);
   void save(const std::string& filename, std::ios_base::openmode);
+  // Inserts the last `max_size` non-empty lines of `filename`. The file is
+  // mapped and scanned backwards, so the cost depends on `max_size` rather
+  // than on the size of the file.
   void load(const std::string& filename);
+  // Loads `filename` and makes it this session's history file, which
+  // `persist` appends to.
+  void attach(const std::string& filename);
+  // Appends the entries inserted since the last call to the attached file
+  // with a single O_APPEND write.
+  void persist();
+  // Inserts the entries other sessions appended to the attached file since it
+  // was loaded or last merged, reading only the bytes added since then.
+  // Returns the number of entries inserted.
+  size_t merge();
   std::string getCurrentTxt();
+  // Entry `i`, counting from the oldest. The view is invalidated by the next
+  // modification.
+  std::string_view operator[](size_t i) const;
+  // When entry `i` was run (seconds since the epoch), or 0 if unknown.
+  int64_t timestamp(size_t i) const;
+  // Index of the newest entry older than entry `before` containing `query`,
+  // or `size` if there's none. Queries of `kGramSize` bytes or more are
+  // answered from a trigram index kept up to date by `insert`, so the cost
+  // depends on the number of candidates rather than on `size`.
+  size_t search(std::string_view query, size_t before) const;
+  Iterator begin() const;
+  Iterator end() const;
+  // Copies of the entries, newest first.
   std::vector<std::string> get();
+  // Copies of the entries, oldest first.
   std::vector<std::string> getReverse();
   History();
-  History(size_t max_size);
+  explicit History(size_t max_size);
   ~History();
+  History(const History&) = delete;
+  History& operator=(const History&) = delete;
 
  private:
-  Node* head;
-  Node* tail;
-  Node* current;
-  Node* last_written;
-  void deleteTail();
-  void deleteNode(Node* node);
-  void initalize();
+  struct Span {
+    uint32_t offset;
+    uint32_t len;
+    // Session that ran the entry; 0 if unknown.
+    uint32_t session;
+    int64_t time;
+  };
+  std::string arena;
+  // Bytes of `arena` no entry points to anymore.
+  size_t dead_bytes;
+  // Ring of entries; `oldest` is the slot of entry 0.
+  std::vector<Span> entries;
+  size_t oldest;
+  // Text being edited at the prompt.
+  std::string scratch;
+  // 0 is the scratch slot, 1 the newest entry, `size` the oldest.
+  size_t current;
+  // Sequence number of the oldest entry; entry i has `first_seq + i`.
+  uint64_t first_seq;
+  // Sequence number of the first entry not yet appended by `save`.
+  uint64_t unwritten_seq;
+  // Identifies this shell in the records it writes.
+  uint32_t session;
+  // Attached history file, opened on the first `persist`.
+  std::string file_path;
+  int file_fd;
+  // Sequence number of the first entry not yet appended by `persist`.
+  uint64_t persisted_seq;
+  // Bytes of the attached file already loaded or merged.
+  uint64_t read_offset;
+  // Byte ranges (offset, length) this session appended past `read_offset`,
+  // which `merge` must skip.
+  std::vector<std::pair<uint64_t, uint64_t>> own_writes;
+  TrigramIndex index;
+  // Postings below this sequence number have been pruned from `index`.
+  uint64_t pruned_seq;
+  Span& span(size_t i);
+  void push(std::string_view txt, int64_t time, uint32_t session);
+  // Entries from sequence number `seq` on, as records to save.
+  std::string since(uint64_t seq) const;
+  // Inserts the records in `data`, which starts at byte `offset` of the
+  // attached file, skipping the ranges in `own_writes`.
+  size_t pushRecords(std::string_view data, uint64_t offset);
+  // Loads `filename` and returns its size.
+  uint64_t loadFile(const std::string& filename);
+  Span store(std::string_view txt);
+  void release(const Span& span);
+  void compact();
 };
 
 extern History* GLOBAL_HISTORY;
-std::vector<std::string> GetHistory();
+const History& GetHistory();
+
+// The `history` builtin, acting on `GLOBAL_HISTORY`. Lists the last N (by
+// default all) entries into `out`, stamped with HISTTIMEFORMAT when it's set,
+// streaming them straight from the history's arena. `-r`, `-w` and `-a` read,
+// write and append a file, and `-n` merges other sessions' entries.
+int HistoryCommand(std::span<const std::string_view> args,
+                   shell::io::OutputSink* out);
 
 int ArrowHistory(int count, int key);
+// readline command for an incremental reverse search (C-r) through
+// `GLOBAL_HISTORY`.
+int ReverseSearch(int count, int key);
 }  // namespace shell::history
 
 #endif  // SRC_HISTORY_H_
@@ -0,0 +1,63 @@
+#ifndef SRC_HISTORY_INDEX_CPP_
+#define SRC_HISTORY_INDEX_CPP_
+
+#include "./history_index.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace hist = shell::history;
+
+namespace {
+uint32_t Gram(std::string_view txt, size_t i) {
+  return static_cast<uint8_t>(txt[i]) |
+         static_cast<uint8_t>(txt[i + 1]) << 8 |
+         static_cast<uint32_t>(static_cast<uint8_t>(txt[i + 2])) << 16;
+}
+}  // namespace
+
+hist::TrigramIndex::TrigramIndex() : count(0) {}
+
+void hist::TrigramIndex::add(uint64_t seq, std::string_view txt) {
+  for (size_t i = 0; i + kGramSize <= txt.size(); i++) {
+    auto& list = this->postings[Gram(txt, i)];
+    // A trigram repeated within the entry is only listed once.
+    if (list.empty() || list.back() != seq) {
+      list.push_back(seq);
+      this->count++;
+    }
+  }
+}
+
+void hist::TrigramIndex::prune(uint64_t first_seq) {
+  for (auto it = this->postings.begin(); it != this->postings.end();) {
+    auto& list = it->second;
+    auto keep = std::lower_bound(list.begin(), list.end(), first_seq);
+    this->count -= keep - list.begin();
+    list.erase(list.begin(), keep);
+    if (list.empty()) {
+      it = this->postings.erase(it);
+    } else {
+      it++;
+    }
+  }
+}
+
+const std::vector<uint64_t>* hist::TrigramIndex::candidates(
+    std::string_view query) const {
+  const std::vector<uint64_t>* shortest = nullptr;
+  for (size_t i = 0; i + kGramSize <= query.size(); i++) {
+    auto it = this->postings.find(Gram(query, i));
+    if (it == this->postings.end()) return nullptr;
+    if (shortest == nullptr || it->second.size() < shortest->size()) {
+      shortest = &it->second;
+    }
+  }
+  return shortest;
+}
+
+size_t hist::TrigramIndex::size() const { return this->count; }
+
+#endif  // SRC_HISTORY_INDEX_CPP_
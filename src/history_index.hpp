@@ -0,0 +1,41 @@
+#ifndef SRC_HISTORY_INDEX_H_
+#define SRC_HISTORY_INDEX_H_
+
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace shell::history {
+
+// Shortest query the index can answer; shorter ones need a scan.
+constexpr size_t kGramSize = 3;
+
+// Inverted index from each trigram (three consecutive bytes) to the sequence
+// numbers of the history entries containing it, kept in insertion order. Any
+// entry containing a query of at least `kGramSize` bytes appears in the
+// posting list of each of the query's trigrams, so scanning the shortest of
+// those lists finds every match while touching only a few candidates.
+class TrigramIndex {
+ public:
+  TrigramIndex();
+  // Indexes entry `seq`. Sequence numbers must be added in increasing order.
+  void add(uint64_t seq, std::string_view txt);
+  // Drops the postings of entries below `first_seq`.
+  void prune(uint64_t first_seq);
+  // The shortest posting list among the trigrams of `query`, or null when
+  // one of them never occurs. `query` must be at least `kGramSize` long.
+  const std::vector<uint64_t>* candidates(std::string_view query) const;
+  // Number of postings held.
+  size_t size() const;
+
+ private:
+  // Keyed by the trigram's bytes. Sequence numbers are stored whole, since
+  // a long-lived shared history can go past 2^32 entries.
+  std::unordered_map<uint32_t, std::vector<uint64_t>> postings;
+  size_t count;
+};
+
+}  // namespace shell::history
+
+#endif  // SRC_HISTORY_INDEX_H_
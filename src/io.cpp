@@ -0,0 +1,221 @@
+#ifndef SRC_IO_CPP_
+#define SRC_IO_CPP_
+
+#include "./io.hpp"
+
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace sio = shell::io;
+
+namespace {
+
+// A seekable shared fd is read again from the end of every line, so it's
+// read in smaller chunks.
+constexpr size_t kSharedChunkSize = 4096;
+
+std::system_error IoError(const std::string& what) {
+  return std::system_error(errno, std::generic_category(), what);
+}
+
+}  // namespace
+
+void sio::WriteAll(int fd, std::string_view txt) {
+  while (!txt.empty()) {
+    ssize_t bytes = write(fd, txt.data(), txt.size());
+    if (bytes < 0) {
+      if (errno == EINTR) continue;
+      throw IoError("write");
+    }
+    txt.remove_prefix(bytes);
+  }
+}
+
+sio::LineReader::LineReader(int fd, bool shared)
+    : fd(fd),
+      shared(shared),
+      seekable(lseek(fd, 0, SEEK_CUR) != -1),
+      mapped(nullptr),
+      mapped_size(0),
+      start(0),
+      scanned(0),
+      eof(false) {
+  struct stat s;
+  if (!shared && fstat(fd, &s) == 0 && S_ISREG(s.st_mode) && s.st_size > 0) {
+    void* data = mmap(nullptr, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data != MAP_FAILED) {
+      madvise(data, s.st_size, MADV_SEQUENTIAL);
+      this->mapped = static_cast<const char*>(data);
+      this->mapped_size = s.st_size;
+    }
+  }
+}
+
+sio::LineReader::~LineReader() {
+  if (this->mapped != nullptr) {
+    munmap(const_cast<char*>(this->mapped), this->mapped_size);
+  }
+}
+
+bool sio::LineReader::next(std::string_view* line) {
+  if (this->mapped != nullptr) {
+    if (this->start >= this->mapped_size) return false;
+    const char* begin = this->mapped + this->start;
+    size_t left = this->mapped_size - this->start;
+    auto* nl = static_cast<const char*>(memchr(begin, '\n', left));
+    size_t len = nl == nullptr ? left : nl - begin;
+    *line = std::string_view(begin, len);
+    this->start += len + 1;
+    return true;
+  }
+  while (true) {
+    size_t from = this->start + this->scanned;
+    size_t nl = this->buffer.find('\n', from);
+    if (nl != std::string::npos) {
+      if (this->shared) {
+        // Give back what was read past the line; whoever reads the fd next
+        // may be a command, which then moves the offset itself.
+        off_t ahead = this->buffer.size() - (nl + 1);
+        if (ahead > 0) {
+          lseek(this->fd, -ahead, SEEK_CUR);
+          this->buffer.resize(nl + 1);
+        }
+        this->eof = false;
+      }
+      *line = std::string_view(this->buffer).substr(this->start,
+                                                     nl - this->start);
+      this->start = nl + 1;
+      this->scanned = 0;
+      return true;
+    }
+    if (this->eof) {
+      if (this->start >= this->buffer.size()) return false;
+      *line = std::string_view(this->buffer).substr(this->start);
+      this->start = this->buffer.size();
+      return true;
+    }
+    this->scanned = this->buffer.size() - this->start;
+    this->buffer.erase(0, this->start);
+    this->start = 0;
+    size_t chunk = !this->shared   ? kBufferSize
+                   : this->seekable ? kSharedChunkSize
+                                    : 1;
+    size_t old_size = this->buffer.size();
+    this->buffer.resize(old_size + chunk);
+    ssize_t bytes;
+    do {
+      bytes = read(this->fd, this->buffer.data() + old_size, chunk);
+    } while (bytes < 0 && errno == EINTR);
+    this->buffer.resize(old_size + std::max<ssize_t>(bytes, 0));
+    this->eof = bytes <= 0;
+  }
+}
+
+sio::OutputSink::OutputSink(int fd)
+    : fd(fd),
+      buffer(std::make_unique<char[]>(kBufferSize)),
+      used(0),
+      pending_bytes(0),
+      total(0) {
+  this->pending.reserve(IOV_MAX);
+}
+
+sio::OutputSink::~OutputSink() {
+  try {
+    this->flush();
+  } catch (const std::exception& e) {
+    SPDLOG_DEBUG("Dropping unflushed output: {}.", e.what());
+  }
+}
+
+void sio::OutputSink::write(std::string_view txt) {
+  if (txt.size() > kBufferSize - this->used) {
+    this->flush();
+  }
+  if (txt.size() > kBufferSize) {
+    // Wouldn't fit anyway; write it from where it is.
+    this->queue(txt.data(), txt.size());
+    this->flush();
+    return;
+  }
+  char* dest = this->buffer.get() + this->used;
+  std::memcpy(dest, txt.data(), txt.size());
+  this->used += txt.size();
+  this->queue(dest, txt.size());
+}
+
+void sio::OutputSink::writeRef(std::string_view txt) {
+  if (txt.size() < kCopyThreshold) {
+    this->write(txt);
+    return;
+  }
+  this->queue(txt.data(), txt.size());
+}
+
+void sio::OutputSink::queue(const char* data, size_t len) {
+  if (len == 0) {
+    return;
+  }
+  if (!this->pending.empty()) {
+    iovec& last = this->pending.back();
+    if (static_cast<char*>(last.iov_base) + last.iov_len == data) {
+      last.iov_len += len;
+      this->pending_bytes += len;
+      return;
+    }
+  }
+  this->pending.push_back(iovec{const_cast<char*>(data), len});
+  this->pending_bytes += len;
+  if (this->pending.size() == IOV_MAX || this->pending_bytes >= kBufferSize) {
+    this->flush();
+  }
+}
+
+void sio::OutputSink::flush() {
+  iovec* iov = this->pending.data();
+  size_t count = this->pending.size();
+  while (count > 0) {
+    ssize_t n = writev(this->fd, iov, static_cast<int>(count));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      // Drop what's pending so the destructor doesn't try again.
+      int error = errno;
+      this->pending.clear();
+      this->pending_bytes = 0;
+      this->used = 0;
+      errno = error;
+      throw IoError("write");
+    }
+    this->total += n;
+    // Skip what went out, trimming a partially written piece.
+    while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+      n -= iov->iov_len;
+      iov++;
+      count--;
+    }
+    if (count > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + n;
+      iov->iov_len -= n;
+    }
+  }
+  this->pending.clear();
+  this->pending_bytes = 0;
+  this->used = 0;
+}
+
+size_t sio::OutputSink::written() const { return this->total; }
+
+#endif  // SRC_IO_CPP_
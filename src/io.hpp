@@ -0,0 +1,85 @@
+#ifndef SRC_IO_H_
+#define SRC_IO_H_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shell::io {
+
+// Size of the userspace buffers used for reading and writing.
+constexpr size_t kBufferSize = 1 << 16;
+
+// Writes all of `txt` to `fd`, retrying on short writes and EINTR.
+void WriteAll(int fd, std::string_view txt);
+
+// Reads a file or stream line by line with as few system calls as possible:
+// regular files are mapped whole and everything else is read in
+// `kBufferSize` chunks. A `shared` fd, like the shell's stdin, is also read
+// by the commands being run, so no more than the lines returned is taken
+// from it: a seekable one is read ahead and seeked back to the end of each
+// line, anything else is read a byte at a time.
+class LineReader {
+ public:
+  explicit LineReader(int fd, bool shared = false);
+  ~LineReader();
+  LineReader(const LineReader&) = delete;
+  LineReader& operator=(const LineReader&) = delete;
+  // Sets `line` to the next line, without its newline, and returns false at
+  // EOF. The view is valid until the next call.
+  bool next(std::string_view* line);
+
+ private:
+  int fd;
+  bool shared;
+  bool seekable;
+  const char* mapped;
+  size_t mapped_size;
+  // Unconsumed input starts at `start`; `scanned` bytes past it are known
+  // not to hold a newline.
+  std::string buffer;
+  size_t start;
+  size_t scanned;
+  bool eof;
+};
+
+// Buffers output for `fd` and hands it to the kernel with as few writev(2)
+// calls as possible, so a producer can stream any amount of output in bounded
+// memory. Short pieces are copied into a `kBufferSize` buffer (adjacent ones
+// end up in a single iovec); longer ones are queued by reference. Output is
+// flushed once `kBufferSize` bytes or `IOV_MAX` pieces are pending, on `flush`
+// and, ignoring errors, on destruction. Write errors throw a
+// std::system_error carrying the errno.
+class OutputSink {
+ public:
+  // Pieces shorter than this are copied even when passed to `writeRef`.
+  static constexpr size_t kCopyThreshold = 128;
+  explicit OutputSink(int fd);
+  ~OutputSink();
+  OutputSink(const OutputSink&) = delete;
+  OutputSink& operator=(const OutputSink&) = delete;
+  void write(std::string_view txt);
+  // Queues `txt` without copying it. It must stay valid until the next
+  // flush, which may happen before this returns.
+  void writeRef(std::string_view txt);
+  void flush();
+  // Bytes handed to the kernel so far.
+  size_t written() const;
+
+ private:
+  int fd;
+  std::unique_ptr<char[]> buffer;
+  size_t used;
+  std::vector<iovec> pending;
+  size_t pending_bytes;
+  size_t total;
+  void queue(const char* data, size_t len);
+};
+
+}  // namespace shell::io
+
+#endif  // SRC_IO_H_
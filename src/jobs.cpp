@@ -0,0 +1,573 @@
+#ifndef SRC_JOBS_CPP_
+#define SRC_JOBS_CPP_
+
+#include "./jobs.hpp"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spdlog/spdlog.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "./io.hpp"
+#include "./launcher.hpp"
+#include "./lexer.hpp"
+#include "./parser.hpp"
+#include "./timing.hpp"
+
+namespace sjobs = shell::jobs;
+namespace sio = shell::io;
+namespace launch = shell::launcher;
+namespace slex = shell::lexer;
+namespace sparse = shell::parser;
+namespace stiming = shell::timing;
+
+sjobs::JobTable* sjobs::GLOBAL_JOBS = nullptr;
+
+namespace {
+// Signals an interactive shell leaves to its jobs.
+constexpr int kJobControlSignals[] = {SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU};
+
+std::atomic<bool> interrupted{false};
+
+void InterruptHandler(int) { interrupted = true; }
+
+std::string_view OperatorText(slex::RedirectOp op) {
+  switch (op) {
+    case slex::RedirectOp::OUTPUT:
+      return ">";
+    case slex::RedirectOp::APPEND:
+      return ">>";
+    case slex::RedirectOp::INPUT:
+      return "<";
+    case slex::RedirectOp::DUP_OUTPUT:
+      return ">&";
+    case slex::RedirectOp::DUP_INPUT:
+      return "<&";
+    case slex::RedirectOp::ALL:
+      return "&>";
+    case slex::RedirectOp::APPEND_ALL:
+      return "&>>";
+    case slex::RedirectOp::NONE:
+      break;
+  }
+  return "";
+}
+
+// Signals whose disposition the shell changes, restored for its children.
+sigset_t ChildSignals() {
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGPIPE);
+  sigaddset(&signals, SIGCHLD);
+  for (int signal : kJobControlSignals) {
+    sigaddset(&signals, signal);
+  }
+  return signals;
+}
+
+int StatusOf(int wstatus) {
+  if (WIFEXITED(wstatus)) return WEXITSTATUS(wstatus);
+  if (WIFSIGNALED(wstatus)) return 128 + WTERMSIG(wstatus);
+  if (WIFSTOPPED(wstatus)) return 128 + WSTOPSIG(wstatus);
+  return 0;
+}
+
+// The table behind a job builtin, which only makes sense on the thread
+// that owns it.
+sjobs::JobTable* Table(const std::string& name, bool job_control) {
+  auto* table = sjobs::GLOBAL_JOBS;
+  if (table == nullptr || !table->owner() ||
+      (job_control && !table->jobControl())) {
+    throw std::runtime_error(name + ": no job control");
+  }
+  return table;
+}
+
+sjobs::Job* Find(sjobs::JobTable* table, const std::string& name,
+                 std::string_view spec) {
+  sjobs::Job* job = table->find(spec);
+  if (job == nullptr) {
+    throw std::runtime_error(
+        name + ": " + (spec.empty() ? "current" : std::string(spec)) +
+        ": no such job");
+  }
+  return job;
+}
+}  // namespace
+
+sjobs::State sjobs::Job::state() const {
+  bool stopped = false;
+  for (const auto& process : this->processes) {
+    if (process.state == State::RUNNING) return State::RUNNING;
+    stopped |= process.state == State::STOPPED;
+  }
+  return stopped ? State::STOPPED : State::DONE;
+}
+
+int sjobs::Job::status() const {
+  if (this->processes.empty()) return 0;
+  for (const auto& process : this->processes) {
+    if (process.state == State::STOPPED) return StatusOf(process.wstatus);
+  }
+  return StatusOf(this->processes.back().wstatus);
+}
+
+std::string sjobs::Describe(const sparse::Pipeline& pipeline) {
+  std::string res;
+  for (const auto& command : pipeline.commands) {
+    if (!res.empty()) res += " | ";
+    for (size_t i = 0; i < command.argv.size(); i++) {
+      if (i > 0) res += ' ';
+      res.append(command.argv[i]);
+    }
+    for (const auto& redirect : command.redirects) {
+      res += ' ';
+      if (redirect.fd != -1) res += std::to_string(redirect.fd);
+      res.append(OperatorText(redirect.op));
+      res.append(redirect.target);
+    }
+  }
+  return res;
+}
+
+sjobs::JobTable::JobTable(bool job_control, int tty)
+    : job_control(job_control),
+      tty(tty),
+      shell_pgid(getpgrp()),
+      shell_modes{},
+      signal_fd(-1),
+      owner_thread(std::this_thread::get_id()),
+      clock(0) {
+  if (this->job_control) {
+    // Wait until the shell is in the foreground.
+    while (tcgetpgrp(this->tty) != (this->shell_pgid = getpgrp())) {
+      kill(-this->shell_pgid, SIGTTIN);
+    }
+    for (int signal : kJobControlSignals) {
+      ::signal(signal, SIG_IGN);
+    }
+    // SIGINT only reaches the shell while it's in the foreground itself; it
+    // cuts `wait` short instead of killing the shell.
+    struct sigaction sa {};
+    sa.sa_handler = InterruptHandler;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    // Fails harmlessly when the shell already leads its session.
+    setpgid(0, 0);
+    this->shell_pgid = getpgrp();
+    tcsetpgrp(this->tty, this->shell_pgid);
+    tcgetattr(this->tty, &this->shell_modes);
+  }
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGCHLD);
+  pthread_sigmask(SIG_BLOCK, &mask, &this->old_mask);
+  this->signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (this->signal_fd == -1) {
+    throw std::runtime_error(std::string("signalfd: ") + strerror(errno));
+  }
+}
+
+sjobs::JobTable::~JobTable() {
+  close(this->signal_fd);
+  pthread_sigmask(SIG_SETMASK, &this->old_mask, NULL);
+}
+
+bool sjobs::JobTable::jobControl() const { return this->job_control; }
+
+bool sjobs::JobTable::owner() const {
+  return std::this_thread::get_id() == this->owner_thread;
+}
+
+sjobs::Job* sjobs::JobTable::create(std::string command, bool foreground) {
+  int id = this->jobs.empty() ? 1 : this->jobs.rbegin()->first + 1;
+  Job& job = this->jobs[id];
+  job.id = id;
+  job.pgid = 0;
+  job.command = std::move(command);
+  job.foreground = foreground;
+  job.notified = foreground;
+  job.touched = ++this->clock;
+  job.timed = false;
+  job.has_modes = false;
+  return &job;
+}
+
+void sjobs::JobTable::remove(Job* job) { this->jobs.erase(job->id); }
+
+void sjobs::JobTable::prepare(const Job& job, launch::FileActions* actions,
+                              launch::Attributes* attributes) const {
+  attributes->resetSignals(ChildSignals());
+  if (!this->job_control) {
+    return;
+  }
+  attributes->setProcessGroup(job.pgid);
+  if (job.foreground && job.pgid == 0) {
+    // Must come before any redirection of the terminal's fd.
+    actions->setForeground(this->tty);
+  }
+}
+
+void sjobs::JobTable::addProcess(Job* job, pid_t pid, size_t stage) {
+  if (this->job_control && job->pgid == 0) {
+    job->pgid = pid;
+  }
+  job->processes.push_back(Process{pid, stage, State::RUNNING, 0, {}});
+}
+
+bool sjobs::JobTable::reap() {
+  struct signalfd_siginfo info;
+  while (read(this->signal_fd, &info, sizeof(info)) > 0) {
+  }
+  bool timed = std::any_of(this->jobs.begin(), this->jobs.end(),
+                           [](const auto& entry) { return entry.second.timed; });
+  bool any = false;
+  while (true) {
+    pid_t pid = -1;
+    uint64_t written = 0;
+    if (timed) {
+      // Once reaped, a process's I/O counters are gone.
+      siginfo_t info{};
+      if (waitid(P_ALL, 0, &info,
+                 WEXITED | WSTOPPED | WCONTINUED | WNOHANG | WNOWAIT) == -1 ||
+          info.si_pid == 0) {
+        break;
+      }
+      pid = info.si_pid;
+      if (info.si_code == CLD_EXITED || info.si_code == CLD_KILLED ||
+          info.si_code == CLD_DUMPED) {
+        written = stiming::Written(pid);
+      }
+    }
+    int wstatus;
+    struct rusage usage;
+    pid = wait4(pid, &wstatus, WNOHANG | WUNTRACED | WCONTINUED, &usage);
+    if (pid <= 0) break;
+    any = true;
+    for (auto& [id, job] : this->jobs) {
+      auto process = std::find_if(
+          job.processes.begin(), job.processes.end(),
+          [pid](const Process& process) { return process.pid == pid; });
+      if (process == job.processes.end()) continue;
+      State before = job.state();
+      if (WIFSTOPPED(wstatus)) {
+        process->state = State::STOPPED;
+        process->wstatus = wstatus;
+      } else if (WIFCONTINUED(wstatus)) {
+        process->state = State::RUNNING;
+      } else {
+        process->state = State::DONE;
+        process->wstatus = wstatus;
+        process->usage = stiming::FromRusage(usage);
+        if (job.timed) {
+          process->usage.real = std::chrono::steady_clock::now() - job.started;
+          process->usage.written = written;
+        }
+      }
+      if (job.state() != before) {
+        job.notified = false;
+        if (job.state() == State::STOPPED) job.touched = ++this->clock;
+      }
+      break;
+    }
+  }
+  return any;
+}
+
+bool sjobs::JobTable::waitUntilChanged(Job* job, bool interruptible) {
+  interrupted = false;
+  while (true) {
+    this->reap();
+    if (job->state() != State::RUNNING) return true;
+    pollfd fd{this->signal_fd, POLLIN, 0};
+    if (poll(&fd, 1, -1) == -1 && errno == EINTR && interruptible &&
+        interrupted) {
+      return false;
+    }
+  }
+}
+
+int sjobs::JobTable::foreground(Job* job, bool resume,
+                                std::vector<int>* statuses,
+                                std::vector<stiming::Usage>* usages) {
+  job->foreground = true;
+  if (this->job_control) {
+    tcsetpgrp(this->tty, job->pgid);
+    if (resume && job->has_modes) {
+      tcsetattr(this->tty, TCSADRAIN, &job->modes);
+    }
+  }
+  if (resume) {
+    for (auto& process : job->processes) {
+      if (process.state == State::STOPPED) process.state = State::RUNNING;
+    }
+    kill(this->job_control ? -job->pgid : job->processes.front().pid,
+         SIGCONT);
+  }
+  this->waitUntilChanged(job, false);
+  if (this->job_control) {
+    tcsetpgrp(this->tty, this->shell_pgid);
+    if (job->state() == State::STOPPED) {
+      job->has_modes = tcgetattr(this->tty, &job->modes) == 0;
+    }
+    tcsetattr(this->tty, TCSADRAIN, &this->shell_modes);
+  }
+  int status = job->status();
+  if (job->state() == State::STOPPED) {
+    job->foreground = false;
+    job->notified = true;
+    sio::OutputSink err{STDERR_FILENO};
+    err.write("\n");
+    this->print(*job, false, &err);
+    return status;
+  }
+  for (const auto& process : job->processes) {
+    if (statuses != nullptr) {
+      (*statuses)[process.stage] = StatusOf(process.wstatus);
+    }
+    if (usages != nullptr) {
+      (*usages)[process.stage] = process.usage;
+    }
+  }
+  this->remove(job);
+  return status;
+}
+
+void sjobs::JobTable::background(Job* job) {
+  job->foreground = false;
+  job->touched = ++this->clock;
+  for (auto& process : job->processes) {
+    if (process.state == State::STOPPED) process.state = State::RUNNING;
+  }
+  kill(-job->pgid, SIGCONT);
+}
+
+int sjobs::JobTable::wait(Job* job) {
+  if (!this->waitUntilChanged(job, true)) {
+    return 128 + SIGINT;
+  }
+  int status = job->status();
+  if (job->state() == State::DONE) {
+    this->remove(job);
+  }
+  return status;
+}
+
+const sjobs::Job* sjobs::JobTable::current(const Job* skip) const {
+  auto rank = [](const Job& job) {
+    return std::make_pair(job.state() == State::STOPPED, job.touched);
+  };
+  const Job* best = nullptr;
+  for (const auto& [id, job] : this->jobs) {
+    if (&job == skip || (job.foreground && job.state() == State::RUNNING)) {
+      continue;
+    }
+    if (best == nullptr || rank(job) > rank(*best)) best = &job;
+  }
+  return best;
+}
+
+sjobs::Job* sjobs::JobTable::get(int id) {
+  auto it = this->jobs.find(id);
+  return it == this->jobs.end() ? nullptr : &it->second;
+}
+
+sjobs::Job* sjobs::JobTable::find(std::string_view spec) {
+  if (spec.empty() || spec == "%" || spec == "%%" || spec == "%+" ||
+      spec == "%-") {
+    const Job* job = this->current();
+    if (spec == "%-") job = this->current(job);
+    return job == nullptr ? nullptr : this->get(job->id);
+  }
+  int number = 0;
+  bool percent = spec[0] == '%';
+  std::string_view digits = percent ? spec.substr(1) : spec;
+  auto [end, error] =
+      std::from_chars(digits.data(), digits.data() + digits.size(), number);
+  bool numeric = error == std::errc() && end == digits.data() + digits.size();
+  for (auto& [id, job] : this->jobs) {
+    if (percent && numeric ? id == number
+        : percent          ? job.command.starts_with(digits)
+        : numeric          ? std::any_of(job.processes.begin(),
+                                         job.processes.end(),
+                                         [number](const Process& process) {
+                                           return process.pid == number;
+                                         })
+                           : false) {
+      return &job;
+    }
+  }
+  return nullptr;
+}
+
+const std::map<int, sjobs::Job>& sjobs::JobTable::all() const {
+  return this->jobs;
+}
+
+void sjobs::JobTable::print(const Job& job, bool pids,
+                            sio::OutputSink* out) const {
+  const Job* first = this->current();
+  char mark = &job == first                 ? '+'
+              : &job == this->current(first) ? '-'
+                                             : ' ';
+  std::string state;
+  switch (job.state()) {
+    case State::RUNNING:
+      state = "Running";
+      break;
+    case State::STOPPED:
+      state = "Stopped";
+      break;
+    case State::DONE: {
+      int wstatus = job.processes.empty() ? 0 : job.processes.back().wstatus;
+      if (WIFSIGNALED(wstatus)) {
+        state = strsignal(WTERMSIG(wstatus));
+      } else if (WEXITSTATUS(wstatus) != 0) {
+        state = "Exit " + std::to_string(WEXITSTATUS(wstatus));
+      } else {
+        state = "Done";
+      }
+      break;
+    }
+  }
+  std::string line = "[" + std::to_string(job.id) + "]" + mark + " ";
+  if (pids && !job.processes.empty()) {
+    line += std::to_string(job.processes.front().pid) + " ";
+  } else {
+    line += ' ';
+  }
+  state.resize(std::max<size_t>(state.size() + 1, 24), ' ');
+  line += state + job.command;
+  if (job.state() == State::RUNNING && !job.foreground) {
+    line += " &";
+  }
+  out->write(line + '\n');
+}
+
+void sjobs::JobTable::notify(sio::OutputSink* out) {
+  this->reap();
+  std::vector<Job*> done;
+  for (auto& [id, job] : this->jobs) {
+    if (job.foreground || job.state() == State::RUNNING) continue;
+    if (!job.notified) {
+      this->print(job, false, out);
+      job.notified = true;
+    }
+    if (job.state() == State::DONE) done.push_back(&job);
+  }
+  for (Job* job : done) {
+    this->remove(job);
+  }
+}
+
+int sjobs::JobsCommand(std::span<const std::string_view> args,
+                       sio::OutputSink* out) {
+  JobTable* table = Table("jobs", false);
+  bool pids = false;
+  bool only_pids = false;
+  for (auto arg : args) {
+    if (arg == "-l") {
+      pids = true;
+    } else if (arg == "-p") {
+      only_pids = true;
+    } else {
+      throw std::runtime_error("jobs: " + std::string(arg) +
+                               ": invalid option");
+    }
+  }
+  table->reap();
+  std::vector<int> done;
+  for (const auto& [id, job] : table->all()) {
+    if (job.foreground && job.state() == State::RUNNING) continue;
+    if (only_pids) {
+      if (!job.processes.empty()) {
+        out->write(std::to_string(job.processes.front().pid) + '\n');
+      }
+    } else {
+      table->print(job, pids, out);
+    }
+    if (job.state() == State::DONE) done.push_back(id);
+  }
+  for (int id : done) {
+    table->remove(table->get(id));
+  }
+  return 0;
+}
+
+int sjobs::ForegroundCommand(std::span<const std::string_view> args,
+                             sio::OutputSink* out) {
+  JobTable* table = Table("fg", true);
+  Job* job = Find(table, "fg", args.empty() ? "" : args[0]);
+  out->write(job->command + '\n');
+  out->flush();
+  return table->foreground(job, true);
+}
+
+int sjobs::BackgroundCommand(std::span<const std::string_view> args,
+                             sio::OutputSink* out) {
+  JobTable* table = Table("bg", true);
+  std::vector<std::string_view> specs(args.begin(), args.end());
+  if (specs.empty()) specs.push_back("");
+  for (auto spec : specs) {
+    Job* job = Find(table, "bg", spec);
+    if (job->state() != State::STOPPED) {
+      throw std::runtime_error("bg: job " + std::to_string(job->id) +
+                               " already in background");
+    }
+    table->background(job);
+    out->write("[" + std::to_string(job->id) + "]+ " + job->command + " &\n");
+  }
+  return 0;
+}
+
+int sjobs::WaitCommand(std::span<const std::string_view> args,
+                       sio::OutputSink*) {
+  JobTable* table = Table("wait", false);
+  if (args.empty()) {
+    std::vector<int> ids;
+    for (const auto& [id, job] : table->all()) {
+      if (!job.foreground) ids.push_back(id);
+    }
+    for (int id : ids) {
+      Job* job = table->get(id);
+      if (job != nullptr && table->wait(job) == 128 + SIGINT &&
+          interrupted) {
+        return 128 + SIGINT;
+      }
+    }
+    return 0;
+  }
+  int status = 0;
+  for (auto spec : args) {
+    Job* job = table->find(spec);
+    if (job == nullptr) {
+      throw std::runtime_error("wait: " + std::string(spec) +
+                               ": no such job");
+    }
+    status = table->wait(job);
+  }
+  return status;
+}
+
+#endif  // SRC_JOBS_CPP_
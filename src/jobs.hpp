@@ -0,0 +1,159 @@
+#ifndef SRC_JOBS_H_
+#define SRC_JOBS_H_
+
+#include <signal.h>
+#include <sys/types.h>
+#include <termios.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "./io.hpp"
+#include "./launcher.hpp"
+#include "./parser.hpp"
+#include "./timing.hpp"
+
+namespace shell::jobs {
+
+enum class State { RUNNING, STOPPED, DONE };
+
+struct Process {
+  pid_t pid;
+  // Pipeline stage the process runs.
+  size_t stage;
+  State state;
+  // As reported by wait4(2); meaningful once the process stopped or exited.
+  int wstatus;
+  // What the process cost, once it exited. `real` and `written` are only
+  // measured for a timed job.
+  shell::timing::Usage usage;
+};
+
+struct Job {
+  int id;
+  // Process group of the job's processes; 0 until the first one is spawned
+  // or when job control is off.
+  pid_t pgid;
+  std::string command;
+  std::vector<Process> processes;
+  bool foreground;
+  // Whether the latest state change has been reported.
+  bool notified;
+  // Orders jobs by when they were last started, stopped or continued; the
+  // most recent is the current job (`%+`).
+  uint64_t touched;
+  // Whether the job runs under `time`, and since when.
+  bool timed;
+  std::chrono::steady_clock::time_point started;
+  // Terminal modes the job had when it was stopped.
+  struct termios modes;
+  bool has_modes;
+  // DONE once every process exited, STOPPED once none is left running.
+  State state() const;
+  // Exit status of the last process in the shell's convention: the exit
+  // code, or 128 plus the signal that killed or stopped it.
+  int status() const;
+};
+
+// Text `jobs` shows for `pipeline`.
+std::string Describe(const shell::parser::Pipeline& pipeline);
+
+// The jobs the shell started. SIGCHLD is blocked and read from a signalfd,
+// and `reap` collects every child that changed state with a non-blocking
+// wait4(2), so the shell only ever sleeps on a job it's been asked to wait
+// for. Meant to be used from the thread that created it.
+//
+// With job control on (an interactive shell), each job runs in its own
+// process group, the shell moves itself into its own group and hands the
+// terminal to whichever job is in the foreground, and the job-control
+// signals are ignored so that Ctrl-Z and friends only reach the job.
+class JobTable {
+ public:
+  explicit JobTable(bool job_control, int tty = 0);
+  ~JobTable();
+  JobTable(const JobTable&) = delete;
+  JobTable& operator=(const JobTable&) = delete;
+  bool jobControl() const;
+  // Whether this is the thread jobs may be handled from.
+  bool owner() const;
+  // Starts tracking a job running `command`; processes are added as they're
+  // spawned.
+  Job* create(std::string command, bool foreground);
+  void remove(Job* job);
+  // Sets up `actions` and `attributes` to spawn the next process of `job`.
+  void prepare(const Job& job, shell::launcher::FileActions* actions,
+               shell::launcher::Attributes* attributes) const;
+  // Records `pid`, spawned for stage `stage` of `job`. The first process
+  // leads the job's process group.
+  void addProcess(Job* job, pid_t pid, size_t stage);
+  // Collects every child that stopped, continued or exited, without
+  // blocking. Returns whether any did. While a job is timed, each child is
+  // peeked at before being reaped so what it wrote can still be read.
+  bool reap();
+  // Gives `job` the terminal, continuing it first if `resume`, and waits
+  // until it exits or stops. A finished job is removed, after its statuses
+  // and usage by stage are stored into `statuses` and `usages` when given; a
+  // stopped one is reported. Returns the job's status.
+  int foreground(Job* job, bool resume, std::vector<int>* statuses = nullptr,
+                 std::vector<shell::timing::Usage>* usages = nullptr);
+  // Continues stopped `job` without giving it the terminal.
+  void background(Job* job);
+  // Waits until `job` exits or stops, or SIGINT arrives, and returns its
+  // status (130 when interrupted). A finished job is removed.
+  int wait(Job* job);
+  // Looks up `%n`, `%+`/`%%`, `%-`, `%prefix` or a pid. An empty spec is the
+  // current job. Returns nullptr if there's no such job.
+  Job* find(std::string_view spec);
+  // Job `id`, or nullptr if there's none.
+  Job* get(int id);
+  // Jobs by id.
+  const std::map<int, Job>& all() const;
+  // Writes `job`'s line as `jobs` shows it, with its leader's pid when
+  // `pids`.
+  void print(const Job& job, bool pids, shell::io::OutputSink* out) const;
+  // Reports background jobs that changed state since they were last
+  // reported and forgets the finished ones.
+  void notify(shell::io::OutputSink* out);
+
+ private:
+  bool job_control;
+  int tty;
+  pid_t shell_pgid;
+  struct termios shell_modes;
+  int signal_fd;
+  sigset_t old_mask;
+  std::thread::id owner_thread;
+  std::map<int, Job> jobs;
+  uint64_t clock;
+  // The current job (`%+`): the most recently stopped one, or else the most
+  // recently started. Skipping the current job gives the previous (`%-`).
+  const Job* current(const Job* skip = nullptr) const;
+  // Blocks until `job` is no longer running. Returns false if SIGINT
+  // arrived first and `interruptible`.
+  bool waitUntilChanged(Job* job, bool interruptible);
+};
+
+extern JobTable* GLOBAL_JOBS;
+
+// The `jobs` builtin: lists jobs, with pids for `-l` or only pids for `-p`.
+int JobsCommand(std::span<const std::string_view> args,
+                shell::io::OutputSink* out);
+// The `fg` builtin: brings a job to the foreground and waits for it.
+int ForegroundCommand(std::span<const std::string_view> args,
+                      shell::io::OutputSink* out);
+// The `bg` builtin: continues stopped jobs in the background.
+int BackgroundCommand(std::span<const std::string_view> args,
+                      shell::io::OutputSink* out);
+// The `wait` builtin: waits for the given jobs or pids, or for every job.
+int WaitCommand(std::span<const std::string_view> args,
+                shell::io::OutputSink* out);
+
+}  // namespace shell::jobs
+
+#endif  // SRC_JOBS_H_
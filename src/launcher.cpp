@@ -0,0 +1,89 @@
+#ifndef SRC_LAUNCHER_CPP_
+#define SRC_LAUNCHER_CPP_
+
+#include "./launcher.hpp"
+
+#include <spawn.h>
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+extern char** environ;
+
+namespace launch = shell::launcher;
+
+launch::FileActions::FileActions() {
+  posix_spawn_file_actions_init(&this->actions);
+}
+
+launch::FileActions::~FileActions() {
+  posix_spawn_file_actions_destroy(&this->actions);
+}
+
+void launch::FileActions::dup2(int from, int to) {
+  if (from == to) return;
+  posix_spawn_file_actions_adddup2(&this->actions, from, to);
+}
+
+void launch::FileActions::close(int fd) {
+  posix_spawn_file_actions_addclose(&this->actions, fd);
+}
+
+void launch::FileActions::setForeground(int fd) {
+  posix_spawn_file_actions_addtcsetpgrp_np(&this->actions, fd);
+}
+
+const posix_spawn_file_actions_t* launch::FileActions::get() const {
+  return &this->actions;
+}
+
+launch::Attributes::Attributes() : flags(0) {
+  posix_spawnattr_init(&this->attr);
+}
+
+launch::Attributes::~Attributes() { posix_spawnattr_destroy(&this->attr); }
+
+void launch::Attributes::setProcessGroup(pid_t pgid) {
+  posix_spawnattr_setpgroup(&this->attr, pgid);
+  this->flags |= POSIX_SPAWN_SETPGROUP;
+  posix_spawnattr_setflags(&this->attr, this->flags);
+}
+
+void launch::Attributes::resetSignals(const sigset_t& signals) {
+  sigset_t none;
+  sigemptyset(&none);
+  posix_spawnattr_setsigdefault(&this->attr, &signals);
+  posix_spawnattr_setsigmask(&this->attr, &none);
+  this->flags |= POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+  posix_spawnattr_setflags(&this->attr, this->flags);
+}
+
+const posix_spawnattr_t* launch::Attributes::get() const {
+  return &this->attr;
+}
+
+pid_t launch::Spawn(const std::string& path,
+                    const std::vector<std::string>& argv,
+                    const FileActions& actions,
+                    const Attributes* attributes) {
+  std::vector<char*> c_argv;
+  c_argv.reserve(argv.size() + 1);
+  for (const auto& arg : argv) {
+    c_argv.push_back(const_cast<char*>(arg.c_str()));
+  }
+  c_argv.push_back(nullptr);
+  pid_t pid;
+  int err = posix_spawn(&pid, path.c_str(), actions.get(),
+                        attributes != nullptr ? attributes->get() : nullptr,
+                        c_argv.data(), environ);
+  if (err != 0) {
+    throw std::runtime_error(path + ": " + std::strerror(err));
+  }
+  SPDLOG_DEBUG("Spawned {} as pid {}.", path, pid);
+  return pid;
+}
+
+#endif  // SRC_LAUNCHER_CPP_
@@ -0,0 +1,64 @@
+#ifndef SRC_LAUNCHER_H_
+#define SRC_LAUNCHER_H_
+
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+namespace shell::launcher {
+
+// fd operations applied in the child between spawn and exec, in the order
+// they were added.
+class FileActions {
+ public:
+  FileActions();
+  ~FileActions();
+  FileActions(const FileActions&) = delete;
+  FileActions& operator=(const FileActions&) = delete;
+  // Makes `to` refer to `from` in the child. A no-op when they're equal.
+  void dup2(int from, int to);
+  void close(int fd);
+  // Makes the child's process group the foreground group of the terminal
+  // open as `fd`. Happens in the child, so it can't read the terminal before
+  // it owns it.
+  void setForeground(int fd);
+  const posix_spawn_file_actions_t* get() const;
+
+ private:
+  posix_spawn_file_actions_t actions;
+};
+
+// Process attributes applied in the child before exec.
+class Attributes {
+ public:
+  Attributes();
+  ~Attributes();
+  Attributes(const Attributes&) = delete;
+  Attributes& operator=(const Attributes&) = delete;
+  // Puts the child in process group `pgid`, or in a new one it leads when
+  // `pgid` is 0.
+  void setProcessGroup(pid_t pgid);
+  // Restores the default action of `signals` and unblocks every signal, so
+  // the child doesn't inherit what the shell ignores or blocks.
+  void resetSignals(const sigset_t& signals);
+  const posix_spawnattr_t* get() const;
+
+ private:
+  posix_spawnattr_t attr;
+  short flags;
+};
+
+// Starts `path` with `argv` (argv[0] included) in a single posix_spawn(3),
+// which glibc implements with clone(CLONE_VM | CLONE_VFORK) so the shell's
+// address space is never copied. Returns the child's pid and throws if the
+// program couldn't be started.
+pid_t Spawn(const std::string& path, const std::vector<std::string>& argv,
+            const FileActions& actions,
+            const Attributes* attributes = nullptr);
+
+}  // namespace shell::launcher
+
+#endif  // SRC_LAUNCHER_H_
@@ -0,0 +1,197 @@
+#ifndef SRC_LEXER_CPP_
+#define SRC_LEXER_CPP_
+
+#include "./lexer.hpp"
+
+#include <array>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace slex = shell::lexer;
+
+namespace {
+enum class CharClass : uint8_t {
+  ORDINARY,
+  BLANK,
+  OPERATOR,
+  SINGLE_QUOTE,
+  DOUBLE_QUOTE,
+  BACKSLASH,
+  COMMENT,
+};
+
+constexpr std::array<CharClass, 256> MakeClassTable() {
+  std::array<CharClass, 256> table{};
+  table.fill(CharClass::ORDINARY);
+  for (unsigned char c : std::string_view(" \t\n\r")) {
+    table[c] = CharClass::BLANK;
+  }
+  for (unsigned char c : std::string_view("|&;<>")) {
+    table[c] = CharClass::OPERATOR;
+  }
+  table['\''] = CharClass::SINGLE_QUOTE;
+  table['"'] = CharClass::DOUBLE_QUOTE;
+  table['\\'] = CharClass::BACKSLASH;
+  table['#'] = CharClass::COMMENT;
+  return table;
+}
+
+constexpr std::array<CharClass, 256> kClasses = MakeClassTable();
+
+CharClass Classify(char c) { return kClasses[static_cast<unsigned char>(c)]; }
+
+// Characters a backslash escapes inside double quotes.
+bool IsDoubleQuoteEscape(char c) {
+  return c == '"' || c == '\\' || c == '$' || c == '`' || c == '\n';
+}
+
+bool IsNumber(std::string_view txt) {
+  if (txt.empty() || txt.size() > 4) return false;
+  for (char c : txt) {
+    if (c < '0' || c > '9') return false;
+  }
+  return true;
+}
+}  // namespace
+
+const std::vector<slex::Token>& slex::Lexer::lex(std::string_view input) {
+  this->tokens.clear();
+  this->cooked.clear();
+  // Resolving quotes only ever shrinks a word, so this never reallocates and
+  // views into it stay valid.
+  this->cooked.reserve(input.size());
+  size_t i = 0;
+  while (i < input.size()) {
+    switch (Classify(input[i])) {
+      case CharClass::BLANK:
+        i++;
+        break;
+      case CharClass::COMMENT:
+        // Only at the start of a word; inside one `#` is ordinary.
+        return this->tokens;
+      case CharClass::OPERATOR:
+        i = this->lexOperator(input, i, -1);
+        break;
+      default:
+        i = this->lexWord(input, i);
+        break;
+    }
+  }
+  return this->tokens;
+}
+
+size_t slex::Lexer::lexWord(std::string_view input, size_t i) {
+  size_t start = i;
+  size_t cooked_start = std::string::npos;
+  // Switches to copying into `cooked` once the word needs rewriting.
+  auto cook = [&]() {
+    if (cooked_start == std::string::npos) {
+      cooked_start = this->cooked.size();
+      this->cooked.append(input.substr(start, i - start));
+    }
+  };
+  while (i < input.size()) {
+    char c = input[i];
+    CharClass cls = Classify(c);
+    if (cls == CharClass::BLANK || cls == CharClass::OPERATOR) {
+      break;
+    } else if (cls == CharClass::BACKSLASH) {
+      cook();
+      if (i + 1 < input.size()) {
+        this->cooked += input[i + 1];
+      }
+      i += 2;
+    } else if (cls == CharClass::SINGLE_QUOTE) {
+      cook();
+      size_t end = input.find('\'', i + 1);
+      if (end == std::string_view::npos) {
+        throw std::runtime_error(
+            "unexpected EOF while looking for matching `''");
+      }
+      this->cooked.append(input.substr(i + 1, end - i - 1));
+      i = end + 1;
+    } else if (cls == CharClass::DOUBLE_QUOTE) {
+      cook();
+      for (i++; i < input.size() && input[i] != '"'; i++) {
+        if (input[i] == '\\' && i + 1 < input.size() &&
+            IsDoubleQuoteEscape(input[i + 1])) {
+          i++;
+        }
+        this->cooked += input[i];
+      }
+      if (i >= input.size()) {
+        throw std::runtime_error(
+            "unexpected EOF while looking for matching `\"'");
+      }
+      i++;
+    } else {
+      if (cooked_start != std::string::npos) {
+        this->cooked += c;
+      }
+      i++;
+    }
+  }
+  i = std::min(i, input.size());
+  std::string_view text =
+      cooked_start == std::string::npos
+          ? input.substr(start, i - start)
+          : std::string_view(this->cooked).substr(cooked_start);
+  // `2>file`: an unquoted number glued to a redirection names the fd.
+  if (cooked_start == std::string::npos && i < input.size() &&
+      (input[i] == '>' || input[i] == '<') && IsNumber(text)) {
+    return this->lexOperator(input, i, std::stoi(std::string(text)));
+  }
+  this->tokens.push_back(Token{TokenType::WORD, text, RedirectOp::NONE, -1});
+  return i;
+}
+
+size_t slex::Lexer::lexOperator(std::string_view input, size_t i, int fd) {
+  auto at = [&](size_t k) { return i + k < input.size() ? input[i + k] : '\0'; };
+  TokenType type = TokenType::REDIRECT;
+  RedirectOp op = RedirectOp::NONE;
+  size_t len = 1;
+  switch (input[i]) {
+    case '|':
+      type = at(1) == '|' ? TokenType::OR : TokenType::PIPE;
+      len = at(1) == '|' ? 2 : 1;
+      break;
+    case ';':
+      type = TokenType::SEMICOLON;
+      break;
+    case '&':
+      if (at(1) == '&') {
+        type = TokenType::AND;
+        len = 2;
+      } else if (at(1) == '>') {
+        op = at(2) == '>' ? RedirectOp::APPEND_ALL : RedirectOp::ALL;
+        len = at(2) == '>' ? 3 : 2;
+      } else {
+        type = TokenType::AMPERSAND;
+      }
+      break;
+    case '>':
+      if (at(1) == '>') {
+        op = RedirectOp::APPEND;
+        len = 2;
+      } else if (at(1) == '&') {
+        op = RedirectOp::DUP_OUTPUT;
+        len = 2;
+      } else {
+        op = RedirectOp::OUTPUT;
+        // `>|` overrides noclobber, which we don't have.
+        len = at(1) == '|' ? 2 : 1;
+      }
+      break;
+    case '<':
+      op = at(1) == '&' ? RedirectOp::DUP_INPUT : RedirectOp::INPUT;
+      len = at(1) == '&' ? 2 : 1;
+      break;
+  }
+  this->tokens.push_back(Token{type, input.substr(i, len), op, fd});
+  return i + len;
+}
+
+#endif  // SRC_LEXER_CPP_
@@ -0,0 +1,55 @@
+#ifndef SRC_LEXER_H_
+#define SRC_LEXER_H_
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shell::lexer {
+
+enum class TokenType { WORD, PIPE, REDIRECT, AMPERSAND, SEMICOLON, AND, OR };
+
+enum class RedirectOp {
+  NONE,
+  OUTPUT,      // >
+  APPEND,      // >>
+  INPUT,       // <
+  DUP_OUTPUT,  // >&
+  DUP_INPUT,   // <&
+  ALL,         // &>
+  APPEND_ALL,  // &>>
+};
+
+struct Token {
+  TokenType type;
+  // Words with their quotes and escapes already resolved; the operator itself
+  // for everything else.
+  std::string_view text;
+  RedirectOp op;
+  // File descriptor written before a redirection operator (the 2 in `2>`), or
+  // -1 when the operator's default applies.
+  int fd;
+};
+
+// Splits command lines into tokens in a single pass driven by a character
+// class table. Quotes and backslashes are resolved while scanning, so words
+// never need to be re-parsed. Words without any quoting are views straight
+// into the input; the others are written once into a buffer owned by the
+// lexer, which is sized up front so the views stay put.
+class Lexer {
+ public:
+  // Tokenizes `input`, throwing std::runtime_error on an unterminated quote.
+  // The tokens reference `input` and the lexer, and are valid until the next
+  // call or until `input` goes away.
+  const std::vector<Token>& lex(std::string_view input);
+
+ private:
+  std::string cooked;
+  std::vector<Token> tokens;
+  size_t lexWord(std::string_view input, size_t i);
+  size_t lexOperator(std::string_view input, size_t i, int fd);
+};
+
+}  // namespace shell::lexer
+
+#endif  // SRC_LEXER_H_
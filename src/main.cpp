@@ -3,35 +3,84 @@
 
 #include "./main.hpp"
 
+#include <fcntl.h>
+#include <pthread.h>
 #include <readline/readline.h>
+#include <signal.h>
 #include <spdlog/spdlog.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
 #include <exception>
 #include <filesystem>
-#include <fstream>
 #include <functional>
 #include <iostream>
-#include <ranges>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "./arena.hpp"
 #include "./history.hpp"
+#include "./io.hpp"
+#include "./jobs.hpp"
+#include "./launcher.hpp"
+#include "./parser.hpp"
+#include "./path_cache.hpp"
+#include "./path_index.hpp"
+#include "./profile.hpp"
+#include "./redirect.hpp"
+#include "./timing.hpp"
+#include "./trace.hpp"
 #include "./trie.hpp"
 #include "./utils.hpp"
 
 namespace fs = std::filesystem;
+namespace sarena = shell::arena;
 namespace shist = shell::history;
+namespace sio = shell::io;
+namespace sjobs = shell::jobs;
+namespace launch = shell::launcher;
+namespace sparse = shell::parser;
+namespace spc = shell::path_cache;
+namespace spi = shell::path_index;
+namespace sprof = shell::profile;
+namespace sredir = shell::redirect;
+namespace strace = shell::trace;
+namespace stiming = shell::timing;
 
-bool run = true;
+std::atomic<bool> run{true};
+std::vector<int> GLOBAL_PIPESTATUS;
+
+// A thread feeding a background job from a builtin. The shell doesn't wait
+// for it, but joins it before anything it uses goes away.
+struct BackgroundFeed {
+  std::thread thread;
+  std::shared_ptr<std::atomic<bool>> done;
+};
+std::vector<BackgroundFeed> background_feeds;
+
+// Joins the background feeds that are done, or all of them when `all`.
+void JoinBackgroundFeeds(bool all) {
+  std::erase_if(background_feeds, [all](BackgroundFeed &feed) {
+    if (!all && !feed.done->load()) return false;
+    feed.thread.join();
+    return true;
+  });
+}
 
 void sigterm_handler(int signal) {
   if (signal == SIGTERM) {
@@ -39,290 +88,582 @@ void sigterm_handler(int signal) {
   }
 }
 
-int main() {
+// Writes an error message to `fd`, which a redirection may have closed.
+void Diagnose(int fd, const std::string &message) {
+  try {
+    sio::WriteAll(fd, message + '\n');
+  } catch (const std::exception &) {
+  }
+}
+
+// Where a builtin runs when it isn't the last stage of a foreground
+// pipeline, and so can't simply run in the shell.
+enum class Placement {
+  // On a thread of its own, since it only writes output.
+  THREAD,
+  // In the shell, into a memory file a thread then feeds to the pipe, since
+  // it reads state that only the shell thread may touch.
+  SHELL,
+  // Nowhere: it changes the shell, which a subshell couldn't either.
+  REFUSED,
+};
+
+Placement Place(const sparse::Command &command) {
+  std::string_view name = command.argv[0];
+  auto args = command.argv.subspan(1);
+  if (name == "echo" || name == "pwd" || name == "type") {
+    return Placement::THREAD;
+  }
+  if (name == "profile") {
+    return args.empty() || args[0] == "show" || args[0] == "json"
+               ? Placement::THREAD
+               : Placement::REFUSED;
+  }
+  // `set -o` alone lists the options; anything else sets them.
+  if (name == "set") {
+    return args.size() == 1 && (args[0] == "-o" || args[0] == "+o")
+               ? Placement::THREAD
+               : Placement::REFUSED;
+  }
+  // The shell thread leaves the history alone while a pipeline runs, and the
+  // path cache locks; only listing them is allowed.
+  if (name == "history") {
+    bool changes = std::any_of(args.begin(), args.end(), [](auto arg) {
+      return arg == "-r" || arg == "-w" || arg == "-a" || arg == "-n";
+    });
+    return changes ? Placement::REFUSED : Placement::THREAD;
+  }
+  if (name == "hash") {
+    bool listing = std::all_of(args.begin(), args.end(),
+                               [](auto arg) { return arg == "-l"; });
+    return listing ? Placement::THREAD : Placement::REFUSED;
+  }
+  // The job table belongs to the shell thread.
+  if (name == "jobs") {
+    return Placement::SHELL;
+  }
+  return Placement::REFUSED;
+}
+
+// Copies what a builtin left in the memory file `source`, from its start, to
+// `out_fd`.
+void Replay(int source, int out_fd) {
+  std::string buffer(sio::kBufferSize, '\0');
+  off_t offset = 0;
+  ssize_t bytes;
+  while ((bytes = pread(source, buffer.data(), buffer.size(), offset)) > 0) {
+    sio::WriteAll(out_fd, std::string_view(buffer.data(), bytes));
+    offset += bytes;
+  }
+}
+
+// Copies `command` into `arena`, so that it outlives the parse cache entry
+// it came from.
+sparse::Command CopyCommand(const sparse::Command &command,
+                            sarena::Arena *arena) {
+  std::vector<std::string_view> argv;
+  for (auto word : command.argv) {
+    argv.push_back(arena->copy(word));
+  }
+  std::vector<sparse::Redirect> redirects(command.redirects.begin(),
+                                          command.redirects.end());
+  for (auto &redirect : redirects) {
+    redirect.target = arena->copy(redirect.target);
+  }
+  return {arena->copy(std::span<const std::string_view>(argv)),
+          arena->copy(std::span<const sparse::Redirect>(redirects))};
+}
+
+// Makes a reader that exits early fail the calling thread's writes with
+// EPIPE rather than kill the shell.
+void BlockPipeSignal() {
+  sigset_t pipe_signal;
+  sigemptyset(&pipe_signal);
+  sigaddset(&pipe_signal, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_signal, NULL);
+}
+
+// Body of the thread feeding the pipe `out_fd` from a builtin that isn't the
+// last stage: runs `command`, or replays its output from the memory file
+// `source` when the shell already ran it, then closes both.
+void FeedStage(const sparse::Command &command, int source, int out_fd,
+               const Builtins &builtin_commands, int *status,
+               stiming::Usage *usage) {
+  BlockPipeSignal();
+  if (source == -1) {
+    ExecuteInput(command, STDIN_FILENO, out_fd, builtin_commands, status,
+                 nullptr, usage);
+  } else {
+    try {
+      Replay(source, out_fd);
+    } catch (const std::system_error &e) {
+      if (status != nullptr) {
+        *status = e.code() == std::errc::broken_pipe ? 128 + SIGPIPE : 1;
+      }
+    }
+    close(source);
+  }
+  close(out_fd);
+}
+
+int main(int argc, char **argv) {
   char *val = getenv("HISTFILE");
   static const std::string kHistoryFile = val == NULL ? std::string(".shell_history") : std::string(val);
+  if (getenv("SHELL_PROFILE") != NULL) {
+    sprof::SetEnabled(true);
+  }
   std::cout << std::unitbuf;
   std::cerr << std::unitbuf;
-  std::unordered_map<std::string,
-                     std::function<std::string(const std::string &)>>
-      builtin_commands = {
+  Builtins builtin_commands = {
           {"exit",
-           [](const std::string &) -> std::string {
-             shist::GLOBAL_HISTORY->save(kHistoryFile, std::ios_base::app);
-             kill(getppid(), SIGTERM);
-             return "";
+           [](Args, sio::OutputSink *) {
+             if (shist::GLOBAL_HISTORY != nullptr) {
+               shist::GLOBAL_HISTORY->persist();
+             }
+             run = false;
+             return 0;
+           }},
+          {"echo",
+           [](Args args, sio::OutputSink *out) {
+             out->write(EchoCommand(args));
+             return 0;
            }},
-          {"echo", EchoCommand},
           {"pwd",
-           [](const std::string &) -> std::string {
+           [](Args, sio::OutputSink *out) {
              fs::path current_dir = fs::current_path();
-             return current_dir.string() + '\n';
+             out->write(current_dir.string() + '\n');
+             return 0;
            }},
-          {"cd", ChangeDirectoryCommand},
-          {"history",
-           [](const std::string &arg) -> std::string {
-             auto history = shist::GetHistory();
-             int hist_size = history.size();
-             if (!arg.empty()) {
-               auto args = SplitText(arg, ' ');
-               for (size_t i = 0; i < args.size(); i++) {
-                 if (args[i] == "-r") {
-                   shist::GLOBAL_HISTORY->load(args[++i]);
-                   return "";
-                 } else if (args[i] == "-w") {
-                   shist::GLOBAL_HISTORY->save(args[++i], std::ios_base::out);
-                   return "";
-                 } else if (args[i] == "-a") {
-                   shist::GLOBAL_HISTORY->save(args[++i], std::ios_base::app);
-                   return "";
-                 } else {
-                   hist_size = std::stoi(args[i]);
-                   if (hist_size < 0) {
-                     throw std::runtime_error("invalid option.");
-                   }
-                 }
-               }
-             }
-             size_t i =
-                 std::max(0, (static_cast<int>(history.size()) - hist_size));
-             std::string res = "";
-             for (i; i < history.size(); i++) {
-               res = res + "    " + std::to_string(i + 1) + "  " + history[i] +
-                     '\n';
-             }
-             return res;
+          {"cd",
+           [](Args args, sio::OutputSink *out) {
+             out->write(ChangeDirectoryCommand(args));
+             return 0;
            }},
+          {"hash",
+           [](Args args, sio::OutputSink *out) {
+             out->write(spc::HashCommand(args));
+             return 0;
+           }},
+          {"history", shist::HistoryCommand},
+          {"set", strace::SetCommand},
+          {"jobs", sjobs::JobsCommand},
+          {"fg", sjobs::ForegroundCommand},
+          {"bg", sjobs::BackgroundCommand},
+          {"wait", sjobs::WaitCommand},
+          {"profile", sprof::ProfileCommand},
       };
   std::unordered_set<std::string> valid_commands;
   for (const auto &pair : builtin_commands) {
     valid_commands.insert(pair.first);
   }
   valid_commands.insert("type");
-  builtin_commands["type"] =
-      [&valid_commands](const std::string &input) -> std::string {
-    return TypeCommand(input, valid_commands);
+  builtin_commands["type"] = [&valid_commands](Args args,
+                                                sio::OutputSink *out) {
+    return TypeCommand(args, valid_commands, out);
   };
 
+  struct sigaction sa;
+  sa.sa_handler = sigterm_handler;
+  sigemptyset(&sa.sa_mask);
+  sa.sa_flags = 0;
+  if (sigaction(SIGTERM, &sa, NULL) == -1) {
+    perror("sigaction");
+    return 1;
+  }
+
+  // Job control needs the terminal, and SIGCHLD has to be blocked before any
+  // thread starts so that none of them takes it.
+  bool interactive = argc == 1 && isatty(STDIN_FILENO);
+  sjobs::JobTable jobs{interactive, STDIN_FILENO};
+  sjobs::GLOBAL_JOBS = &jobs;
+
+  spc::PathCache command_cache = spc::PathCache{};
+  spc::GLOBAL_COMMAND_CACHE = &command_cache;
+  sparse::Parser parser;
+
+  // Batch mode: no prompt, completion or history, just the commands.
+  if (argc > 1 && std::string(argv[1]) == "-c") {
+    if (argc == 2) {
+      std::cerr << "shell: -c: option requires an argument" << std::endl;
+      return 2;
+    }
+    int status = 0;
+    std::string_view commands{argv[2]};
+    while (run && !commands.empty()) {
+      size_t nl = std::min(commands.find('\n'), commands.size());
+      status = RunLine(&parser, commands.substr(0, nl), builtin_commands);
+      commands.remove_prefix(std::min(nl + 1, commands.size()));
+    }
+    JoinBackgroundFeeds(true);
+    return status;
+  } else if (argc > 1) {
+    int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+      perror(argv[1]);
+      return 127;
+    }
+    int status = RunScript(fd, argv[1], &parser, builtin_commands);
+    close(fd);
+    JoinBackgroundFeeds(true);
+    return status;
+  } else if (!isatty(STDIN_FILENO)) {
+    int status = RunScript(STDIN_FILENO, "shell", &parser, builtin_commands);
+    JoinBackgroundFeeds(true);
+    return status;
+  }
+
   Trie trie = Trie{};
   trie.insert("echo");
   trie.insert("exit");
-  FillTrieWithPathExecutables(&trie);
   GLOBAL_TRIE = &trie;
 
+  // Indexed in the background; completion serves whatever is ready. The
+  // watcher starts first so nothing installed during indexing is missed.
+  auto path_entries = GetPathEntries();
+  spi::PathWatcher path_watcher =
+      spi::PathWatcher{&trie, &command_cache, {"echo", "exit"}};
+  path_watcher.start(path_entries);
+  spi::PathIndexer path_indexer = spi::PathIndexer{};
+  path_indexer.start(&trie, path_entries);
+
   shist::History hist = shist::History{};
   shist::GLOBAL_HISTORY = &hist;
-  hist.load(kHistoryFile);
+  hist.timestamps = getenv("HISTTIMEFORMAT") != NULL;
+  hist.attach(kHistoryFile);
 
-  rl_completion_entry_function = &AutoComplete;
+  rl_attempted_completion_function = &AutoComplete;
   rl_bind_key('\t', rl_complete);
   rl_bind_keyseq("\\e[A", &shist::ArrowHistory);
   rl_bind_keyseq("\\e[B", &shist::ArrowHistory);
-  int in_fd = STDIN_FILENO;
-  // spdlog::set_level(spdlog::level::debug);
+  rl_bind_keyseq("\\C-r", &shist::ReverseSearch);
+  // Collect background jobs as they finish rather than at the next command.
+  rl_event_hook = []() {
+    sjobs::GLOBAL_JOBS->reap();
+    return 0;
+  };
+  int status = 0;
   while (run) {
-    char *char_input = readline("$ ");
+    {
+      sio::OutputSink err{STDERR_FILENO};
+      jobs.notify(&err);
+    }
+    char *char_input;
+    {
+      sprof::Scope scope{sprof::Phase::READ};
+      char_input = readline("$ ");
+    }
+    if (char_input == NULL) {
+      // EOF (Ctrl-D).
+      hist.persist();
+      break;
+    }
     std::string user_inputs{char_input};
     free(char_input);
-    if (!Trim(user_inputs).empty()) {
+    if (user_inputs.find_first_not_of(" \t") != std::string::npos) {
       hist.insert(user_inputs);
+      hist.persist();
+    }
+    status = RunLine(&parser, user_inputs, builtin_commands);
+  }
+  JoinBackgroundFeeds(true);
+  return status;
+}
+
+int RunLine(sparse::Parser *parser, std::string_view line,
+            const Builtins &builtin_commands) {
+  const sparse::Program *program;
+  try {
+    sprof::Scope scope{sprof::Phase::PARSE};
+    program = &parser->parse(line);
+  } catch (const std::exception &e) {
+    std::cerr << "shell: " << e.what() << std::endl;
+    return 2;
+  }
+  return RunProgram(*program, builtin_commands);
+}
+
+int RunScript(int fd, const std::string &name, sparse::Parser *parser,
+              const Builtins &builtin_commands) {
+  // Commands run from the script may read the rest of stdin themselves.
+  sio::LineReader reader{fd, fd == STDIN_FILENO};
+  std::string_view line;
+  int status = 0;
+  size_t line_number = 0;
+  auto next = [&reader](std::string_view *line) {
+    sprof::Scope scope{sprof::Phase::READ};
+    return reader.next(line);
+  };
+  while (run && next(&line)) {
+    line_number++;
+    const sparse::Program *program;
+    try {
+      sprof::Scope scope{sprof::Phase::PARSE};
+      program = &parser->parse(line);
+    } catch (const std::exception &e) {
+      std::cerr << name << ": line " << line_number << ": " << e.what()
+                << std::endl;
+      status = 2;
+      continue;
     }
-    auto inputs = SplitText(user_inputs, '|');
-    std::vector<std::pair<pid_t, int>> pids;
-    for (size_t i = 0; i < inputs.size(); i++) {
-      // Need a special exception for cd.
-      auto [command, args] = GetCommandAndArgs(inputs[i]);
-      if (command == "cd" || command == "history") {
-        ExecuteInput(inputs[i], in_fd, STDOUT_FILENO, builtin_commands);
+    status = RunProgram(*program, builtin_commands);
+  }
+  return status;
+}
+
+int RunProgram(const sparse::Program &program,
+               const Builtins &builtin_commands) {
+  int status = 0;
+  for (size_t i = 0; i < program.pipelines.size() && run; i++) {
+    if (i > 0) {
+      auto connector = program.pipelines[i - 1].connector;
+      if ((connector == sparse::Connector::AND && status != 0) ||
+          (connector == sparse::Connector::OR && status == 0)) {
         continue;
       }
-      int pipefd[2];
-      if (pipe(pipefd) == -1) {
-        perror("pipe");
-        exit(1);
-      }
+    }
+    status = RunPipeline(program.pipelines[i], builtin_commands,
+                         &GLOBAL_PIPESTATUS);
+  }
+  return status;
+}
 
-      pid_t pid = fork();
-      if (pid == -1) {
-        perror("fork");
-        exit(1);
+int RunPipeline(const sparse::Pipeline &pipeline,
+                const Builtins &builtin_commands, std::vector<int> *statuses) {
+  sprof::Scope pipeline_scope{sprof::Phase::PIPELINE};
+  JoinBackgroundFeeds(false);
+  const auto &commands = pipeline.commands;
+  std::vector<int> ignored;
+  if (statuses == nullptr) {
+    statuses = &ignored;
+  }
+  statuses->assign(commands.size(), 0);
+  bool background = pipeline.connector == sparse::Connector::BACKGROUND;
+  // A background job isn't waited for, so there's nothing to time.
+  bool timed = pipeline.timed && !background;
+  std::vector<stiming::Usage> usages;
+  std::chrono::steady_clock::time_point started;
+  if (timed) {
+    usages.resize(commands.size());
+    started = std::chrono::steady_clock::now();
+  }
+  sjobs::JobTable *jobs = sjobs::GLOBAL_JOBS;
+  // Created once the first process is about to start, so that builtins
+  // run by the shell itself never show up as jobs.
+  sjobs::Job *job = nullptr;
+  int in_fd = STDIN_FILENO;
+  std::vector<std::thread> builtin_threads;
+  for (size_t i = 0; i < commands.size(); i++) {
+    bool last = i == commands.size() - 1;
+    int pipefd[2] = {STDIN_FILENO, STDOUT_FILENO};
+    // Close-on-exec so spawned stages only see the ends dup'd onto their
+    // stdin/stdout, otherwise readers never get EOF.
+    if (!last && pipe2(pipefd, O_CLOEXEC) == -1) {
+      perror("pipe");
+      exit(1);
+    }
+    bool builtin = !commands[i].argv.empty() &&
+                   builtin_commands.count(std::string(commands[i].argv[0]));
+    int *status = &(*statuses)[i];
+    stiming::Usage *usage = timed ? &usages[i] : nullptr;
+    pid_t pid = 0;
+    if (job == nullptr && !builtin) {
+      job = jobs->create(sjobs::Describe(pipeline), !background);
+      job->timed = timed;
+      job->started = started;
+    }
+    Placement placement = builtin && (background || !last)
+                              ? Place(commands[i])
+                              : Placement::SHELL;
+    if (placement == Placement::REFUSED) {
+      // Its changes would be lost with the subshell it would get elsewhere,
+      // as with `cd dir | cat` or `cd dir &`, so it's refused.
+      Diagnose(STDERR_FILENO,
+               "shell: " + std::string(commands[i].argv[0]) +
+                   ": only runs as the last stage of a foreground pipeline");
+      *status = 1;
+      if (!last) {
+        close(pipefd[1]);
       }
-      if (pid == 0) {
-        close(pipefd[0]);
-        if (i < inputs.size() - 1) {
-          ExecuteInput(inputs[i], in_fd, pipefd[1], builtin_commands);
-        } else {
-          close(pipefd[1]);
-          ExecuteInput(inputs[i], in_fd, STDOUT_FILENO, builtin_commands);
+    } else if (builtin && !last) {
+      // Mid-pipeline, a builtin's output is fed to the pipe from a thread
+      // while the shell starts the next stages. The thread owns the write
+      // end and closes it to signal EOF.
+      int source = -1;
+      if (placement == Placement::SHELL) {
+        source = memfd_create("builtin", MFD_CLOEXEC);
+        if (source == -1) {
+          perror("memfd_create");
+          exit(1);
         }
-        exit(0);
+        ExecuteInput(commands[i], STDIN_FILENO, source, builtin_commands,
+                     status, nullptr, usage);
+      }
+      if (background) {
+        // The shell doesn't wait for a background job, so the thread runs
+        // on past this pipeline, with a copy of the command that outlives
+        // its parse cache entry.
+        auto arena = std::make_unique<sarena::Arena>();
+        sparse::Command command = CopyCommand(commands[i], arena.get());
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        std::thread thread([arena = std::move(arena), command, source, done,
+                            &builtin_commands, out_fd = pipefd[1]]() {
+          FeedStage(command, source, out_fd, builtin_commands, nullptr,
+                    nullptr);
+          *done = true;
+        });
+        background_feeds.push_back({std::move(thread), std::move(done)});
       } else {
+        builtin_threads.emplace_back([&commands, &builtin_commands, i,
+                                      source, status, usage,
+                                      out_fd = pipefd[1]]() {
+          FeedStage(commands[i], source, out_fd, builtin_commands, status,
+                    usage);
+        });
+      }
+    } else {
+      // The last stage's builtin runs right here, in the background too
+      // unless refused above, and external commands are spawned straight
+      // from the shell with their fds wired in.
+      pid = ExecuteInput(commands[i], in_fd, pipefd[1], builtin_commands,
+                         status, job, usage);
+      if (!last) {
         close(pipefd[1]);
-        struct sigaction sa;
-        sa.sa_handler = sigterm_handler;
-        sigemptyset(&sa.sa_mask);
-        sa.sa_flags = 0;
-        if (sigaction(SIGTERM, &sa, NULL) == -1) {
-          perror("sigaction");
-          return 1;
-        }
-        in_fd = pipefd[0];
-        pids.push_back({pid, pipefd[0]});
       }
     }
-    bool first = true;
-    for (auto &[pid, pipe] : std::ranges::views::reverse(pids)) {
-      if (!first) {
-        kill(pid, SIGKILL);
-      }
-      waitpid(pid, NULL, 0);
-      first = false;
-      if (pipe != STDIN_FILENO) {
-        close(pipe);
-      }
+    if (pid > 0) {
+      jobs->addProcess(job, pid, i);
     }
-    in_fd = STDIN_FILENO;
+    if (in_fd != STDIN_FILENO) {
+      close(in_fd);
+    }
+    in_fd = pipefd[0];
+  }
+  if (job != nullptr && background && !job->processes.empty()) {
+    if (jobs->jobControl()) {
+      std::cerr << "[" << job->id << "] " << job->processes.back().pid
+                << std::endl;
+    }
+    return 0;
+  }
+  // Every stage runs to completion, or the job stops as a whole. One whose
+  // reader exits early gets SIGPIPE on its next write, as it would under any
+  // other shell.
+  bool stopped = false;
+  int status = 0;
+  if (job != nullptr) {
+    int id = job->id;
+    sprof::Scope scope{sprof::Phase::WAIT};
+    status = jobs->foreground(job, false, statuses, timed ? &usages : nullptr);
+    stopped = jobs->get(id) != nullptr;
+  }
+  for (auto &thread : builtin_threads) {
+    thread.join();
+  }
+  if (timed && !stopped) {
+    stiming::Usage total;
+    for (const auto &usage : usages) {
+      stiming::Add(&total, usage);
+    }
+    total.real = std::chrono::steady_clock::now() - started;
+    sio::OutputSink err{STDERR_FILENO};
+    err.write(stiming::Report(pipeline, usages, total));
   }
+  return stopped ? status : statuses->back();
 }
 
-void ExecuteInput(
-    const std::string &user_input, int in_fd, int out_fd,
-    std::unordered_map<std::string,
-                       std::function<std::string(const std::string &)>>
-        builtin_commands) {
-  if (in_fd != STDIN_FILENO) {
-    dup2(in_fd, STDIN_FILENO);
-    close(in_fd);
+pid_t ExecuteInput(const sparse::Command &command_node, int in_fd, int out_fd,
+                   const Builtins &builtin_commands, int *status,
+                   sjobs::Job *job, stiming::Usage *usage) {
+  const auto &argv = command_node.argv;
+  int ignored;
+  if (status == nullptr) {
+    status = &ignored;
   }
-  if (out_fd != STDOUT_FILENO) {
-    dup2(out_fd, STDOUT_FILENO);
-    if (out_fd != STDIN_FILENO) {
-      close(out_fd);
-    }
+  sredir::FdTable fds{in_fd, out_fd, STDERR_FILENO};
+  try {
+    sprof::Scope scope{sprof::Phase::REDIRECT};
+    fds.apply(command_node.redirects);
+  } catch (const std::exception &e) {
+    Diagnose(STDERR_FILENO, "shell: " + std::string(e.what()));
+    *status = 1;
+    return 0;
   }
-  auto redirection_info = ParseRedirection(user_input);
-  std::ofstream write_file;
-  if (redirection_info.type != RedirectType::NONE) {
-    fs::path file_path{redirection_info.file};
-    fs::path dir_path = file_path.parent_path();
-    if (!dir_path.empty() && !fs::exists(dir_path)) {
-      fs::create_directories(dir_path);
-    }
-    write_file.open(file_path, redirection_info.open_mode);
+  int stdout_fd = fds.get(STDOUT_FILENO);
+  int stderr_fd = fds.get(STDERR_FILENO);
+  *status = 0;
+  if (argv.empty()) {
+    return 0;
   }
-  auto input = redirection_info.input;
-  spdlog::debug("Input is {}.", input);
-  auto [command, args] = GetCommandAndArgs(input);
-  spdlog::debug("Command is {}. Args are {}.", command, args);
-  if (builtin_commands.count(command)) {
-    try {
-      auto result = builtin_commands[command](args);
-      if (!result.empty()) {
-        if (redirection_info.type == RedirectType::OUTPUT) {
-          write_file << result;
-        } else {
-          std::cout << result;
-        }
+  strace::Command(argv);
+  std::string command{argv[0]};
+  SPDLOG_DEBUG("Command is {}.", command);
+  pid_t pid = 0;
+  auto builtin = builtin_commands.find(command);
+  if (builtin != builtin_commands.end()) {
+    sio::OutputSink output{stdout_fd};
+    auto report = [&](const std::exception &e) {
+      // Keep what the builtin printed ahead of its error.
+      try {
+        output.flush();
+      } catch (const std::exception &) {
       }
-    } catch (const std::exception &e) {
-      if (redirection_info.type == RedirectType::ERROR) {
-        write_file << e.what() << '\n';
+      Diagnose(stderr_fd, e.what());
+      *status = 1;
+    };
+    std::optional<stiming::Stopwatch> stopwatch;
+    if (usage != nullptr) {
+      stopwatch.emplace();
+    }
+    try {
+      sprof::Scope scope{sprof::Phase::BUILTIN};
+      *status = builtin->second(argv.subspan(1), &output);
+      output.flush();
+    } catch (const std::system_error &e) {
+      // A reader that went away is what would have killed a forked stage
+      // with SIGPIPE; report it the same way.
+      if (e.code() == std::errc::broken_pipe) {
+        *status = 128 + SIGPIPE;
       } else {
-        std::cerr << e.what() << '\n';
+        report(e);
       }
+    } catch (const std::exception &e) {
+      report(e);
+    }
+    if (usage != nullptr) {
+      *usage = stopwatch->elapsed();
+      usage->written = output.written();
     }
   } else {
-    auto filepath = GetCommandPath(command);
-    spdlog::debug("File path is {}.", filepath);
-    // bool is whether it has an argument after or not.
-    static std::unordered_map<std::string,
-                              std::unordered_map<std::string, bool>>
-        command_options = {
-            {"tail", {{"-f", false}}},
-            {"head", {{"-n", true}}},
-        };
+    std::string filepath;
+    {
+      sprof::Scope scope{sprof::Phase::RESOLVE};
+      filepath = GetCommandPath(command);
+    }
+    SPDLOG_DEBUG("File path is {}.", filepath);
     if (filepath.empty()) {
-      if (redirection_info.type == RedirectType::ERROR) {
-        write_file << input << ": command not found\n";
-      } else {
-        std::cerr << input << ": command not found\n";
-      }
+      Diagnose(stderr_fd, command + ": command not found");
+      *status = 127;
     } else {
-      int stdoutPipe[2];
-      int stderrPipe[2];
-      pipe(stdoutPipe);
-      pipe(stderrPipe);
-      pid_t pid = fork();
-      if (pid == 0) {
-        dup2(stdoutPipe[1], STDOUT_FILENO);
-        close(stdoutPipe[0]);
-        close(stdoutPipe[1]);
-        dup2(stderrPipe[1], STDERR_FILENO);
-        close(stderrPipe[0]);
-        close(stderrPipe[1]);
-        auto split_args = SplitText(args, ' ', true);
-        std::vector<char *> argv = {const_cast<char *>("stdbuf"),
-                                    const_cast<char *>("-o0"),
-                                    const_cast<char *>(command.c_str())};
-        auto opts = command_options.find(command);
-        // Needed to maintain lifetime, otherwise new_arg released from mem
-        // when dropped from defined scope.
-        std::vector<std::string> joined_args;
-        for (size_t i = 0; i < split_args.size(); i++) {
-          std::string arg = split_args[i];
-          if (opts == command_options.end()) {
-            spdlog::debug("Adding arg {}.", split_args[i]);
-            argv.push_back(const_cast<char *>(split_args[i].c_str()));
-          } else {
-            auto option = opts->second.find(arg);
-            if (option == opts->second.end() || !option->second) {
-              spdlog::debug("Adding arg {}.", split_args[i]);
-              argv.push_back(const_cast<char *>(split_args[i].c_str()));
-            } else {
-              std::string new_arg = arg + split_args[++i];
-              joined_args.push_back(new_arg);
-              spdlog::debug("Adding arg {}.", new_arg);
-              argv.push_back(const_cast<char *>(new_arg.c_str()));
-            }
-          }
-        }
-        argv.push_back(nullptr);
-        if (setvbuf(stdout, NULL, _IOLBF, 0) != 0) {
-          perror("setvbuf failed in child");
-        }
-        execv("/usr/bin/stdbuf", argv.data());
-        perror("execv");
-        exit(1);
-      } else {
-        close(stdoutPipe[1]);
-        close(stderrPipe[1]);
-
-        int kBufferSize = 1;
-        char buffer[kBufferSize];
-        ssize_t bytes;
-        while ((bytes = read(stdoutPipe[0], buffer, kBufferSize)) > 0) {
-          if (redirection_info.type == RedirectType::OUTPUT) {
-            write_file << std::string(buffer, bytes);
-          } else {
-            std::cout << std::string(buffer, bytes) << std::flush;
-          }
-        }
-        while ((bytes = read(stderrPipe[0], buffer, kBufferSize)) > 0) {
-          if (redirection_info.type == RedirectType::ERROR) {
-            write_file << std::string(buffer, bytes);
-          } else {
-            std::cerr << std::string(buffer, bytes);
-          }
-        }
-        close(stdoutPipe[0]);
-        close(stderrPipe[0]);
-        waitpid(pid, NULL, 0);
+      // The child inherits the real target fds, so its output never passes
+      // through the shell.
+      launch::FileActions actions;
+      launch::Attributes attributes;
+      if (job != nullptr && sjobs::GLOBAL_JOBS != nullptr) {
+        sjobs::GLOBAL_JOBS->prepare(*job, &actions, &attributes);
+      }
+      fds.install(&actions);
+      try {
+        sprof::Scope scope{sprof::Phase::SPAWN};
+        pid = launch::Spawn(filepath,
+                            std::vector<std::string>(argv.begin(), argv.end()),
+                            actions, &attributes);
+      } catch (const std::exception &e) {
+        Diagnose(stderr_fd, e.what());
+        *status = 126;
       }
     }
   }
-  if (write_file.is_open()) {
-    write_file.close();
-  }
+  return pid;
 }
 
 #endif  // SRC_MAIN_CPP_
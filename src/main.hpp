@@ -1,14 +1,67 @@
 #ifndef SRC_MAIN_HPP_
 #define SRC_MAIN_HPP_
 
+#include <sys/types.h>
+
 #include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
+
+#include "./io.hpp"
+#include "./jobs.hpp"
+#include "./parser.hpp"
+#include "./timing.hpp"
+#include "./utils.hpp"
+
+// Builtins stream their output into the sink, return their exit status and
+// report errors by throwing.
+using Builtins = std::unordered_map<
+    std::string, std::function<int(Args, shell::io::OutputSink*)>>;
+
+// Parses and runs one command line, returning the status of the last
+// pipeline that ran. Syntax errors are reported on stderr.
+int RunLine(shell::parser::Parser* parser, std::string_view line,
+            const Builtins& builtin_commands);
+
+// Runs the script read from `fd` line by line, without prompting or
+// recording history. `name` prefixes error messages. Returns the status of
+// the last command.
+int RunScript(int fd, const std::string& name, shell::parser::Parser* parser,
+              const Builtins& builtin_commands);
+
+// Runs the pipelines of `program`, honoring `&&` and `||`, and returns the
+// status of the last one that ran.
+int RunProgram(const shell::parser::Program& program,
+               const Builtins& builtin_commands);
+
+// Exit status of every stage of the last pipeline that ran, like bash's
+// PIPESTATUS.
+extern std::vector<int> GLOBAL_PIPESTATUS;
+
+// Runs the commands of `pipeline` connected by pipes as one job, waits for
+// all of them and returns the exit status of the last one. `statuses`, when
+// given, receives the status of each stage. A background pipeline is left
+// running and returns 0 right away. A timed one reports what it and each of
+// its stages cost on stderr. A builtin in the last stage of a foreground
+// pipeline runs in the shell. Any other only runs if it just lists things
+// (echo, pwd, type, `history`, `hash`, `jobs`, `set -o` and `profile` without
+// options that change anything), on a thread or in the shell; one that
+// would change the shell fails with status 1, as its changes would be lost.
+int RunPipeline(const shell::parser::Pipeline& pipeline,
+                const Builtins& builtin_commands,
+                std::vector<int>* statuses = nullptr);
 
-void ExecuteInput(
-    const std::string& user_input, int in_fd, int out_fd,
-    std::unordered_map<std::string,
-                       std::function<std::string(const std::string&)>>
-        builtin_commands);
+// Runs a single pipeline stage reading from `in_fd` and writing to `out_fd`.
+// Builtins run in the calling process; external commands are spawned with
+// their fds wired directly and their pid is returned (0 when nothing was
+// spawned). `status` receives the exit status of whatever ran in-process.
+// A spawned command joins `job` when given. `usage`, when given, receives
+// what a builtin cost; a spawned command's is collected with its job.
+pid_t ExecuteInput(const shell::parser::Command& command, int in_fd,
+                   int out_fd, const Builtins& builtin_commands,
+                   int* status = nullptr, shell::jobs::Job* job = nullptr,
+                   shell::timing::Usage* usage = nullptr);
 
 #endif  // SRC_MAIN_HPP_
@@ -0,0 +1,146 @@
+#ifndef SRC_PARSER_CPP_
+#define SRC_PARSER_CPP_
+
+#include "./parser.hpp"
+
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "./arena.hpp"
+#include "./lexer.hpp"
+
+namespace sarena = shell::arena;
+namespace slex = shell::lexer;
+namespace sparse = shell::parser;
+
+namespace {
+std::runtime_error SyntaxError(std::span<const slex::Token> tokens, size_t i) {
+  std::string near = i < tokens.size() ? std::string(tokens[i].text)
+                                       : std::string("newline");
+  return std::runtime_error("syntax error near unexpected token `" + near +
+                            "'");
+}
+}  // namespace
+
+sparse::Parser::Parser() : hit_count(0) {}
+
+const sparse::Program& sparse::Parser::parse(std::string_view line) {
+  uint64_t key = std::hash<std::string_view>{}(line);
+  auto cached = this->index.find(key);
+  if (cached != this->index.end() && (*cached->second)->line == line) {
+    this->entries.splice(this->entries.begin(), this->entries, cached->second);
+    this->hit_count++;
+    return this->entries.front()->program;
+  }
+  auto parsed = std::make_unique<Parsed>();
+  parsed->line = line;
+  this->build(this->lexer.lex(line), parsed.get());
+  if (cached != this->index.end()) {
+    // A different line with the same hash; the newer one wins.
+    this->entries.erase(cached->second);
+    this->index.erase(cached);
+  }
+  if (this->entries.size() >= kParseCacheSize) {
+    this->index.erase(std::hash<std::string_view>{}(this->entries.back()->line));
+    this->entries.pop_back();
+  }
+  this->entries.push_front(std::move(parsed));
+  this->index[key] = this->entries.begin();
+  return this->entries.front()->program;
+}
+
+size_t sparse::Parser::hits() const { return this->hit_count; }
+
+void sparse::Parser::build(std::span<const slex::Token> tokens,
+                           Parsed* parsed) {
+  this->pipelines.clear();
+  size_t i = 0;
+  while (i < tokens.size()) {
+    i = this->parsePipeline(tokens, i, &parsed->arena);
+    if (i == tokens.size()) break;
+    Connector connector = Connector::SEQUENCE;
+    switch (tokens[i].type) {
+      case slex::TokenType::AND:
+        connector = Connector::AND;
+        break;
+      case slex::TokenType::OR:
+        connector = Connector::OR;
+        break;
+      case slex::TokenType::AMPERSAND:
+        connector = Connector::BACKGROUND;
+        break;
+      case slex::TokenType::SEMICOLON:
+        break;
+      default:
+        throw SyntaxError(tokens, i);
+    }
+    this->pipelines.back().connector = connector;
+    i++;
+    // `a &&` needs a right-hand side; `a ;` and `a &` don't.
+    if (i == tokens.size() &&
+        (connector == Connector::AND || connector == Connector::OR)) {
+      throw SyntaxError(tokens, i);
+    }
+  }
+  parsed->program.pipelines =
+      parsed->arena.copy(std::span<const Pipeline>(this->pipelines));
+}
+
+size_t sparse::Parser::parsePipeline(std::span<const slex::Token> tokens,
+                                     size_t i, sarena::Arena* arena) {
+  this->commands.clear();
+  // `time` is only the keyword when a command follows it.
+  bool timed = i + 1 < tokens.size() &&
+               tokens[i].type == slex::TokenType::WORD &&
+               tokens[i].text == "time" &&
+               (tokens[i + 1].type == slex::TokenType::WORD ||
+                tokens[i + 1].type == slex::TokenType::REDIRECT);
+  if (timed) {
+    i++;
+  }
+  i = this->parseCommand(tokens, i, arena);
+  while (i < tokens.size() && tokens[i].type == slex::TokenType::PIPE) {
+    i = this->parseCommand(tokens, i + 1, arena);
+  }
+  this->pipelines.push_back(
+      Pipeline{arena->copy(std::span<const Command>(this->commands)),
+               Connector::SEQUENCE, timed});
+  return i;
+}
+
+size_t sparse::Parser::parseCommand(std::span<const slex::Token> tokens,
+                                    size_t i, sarena::Arena* arena) {
+  this->words.clear();
+  this->redirects.clear();
+  while (i < tokens.size()) {
+    const auto& token = tokens[i];
+    if (token.type == slex::TokenType::WORD) {
+      this->words.push_back(arena->copy(token.text));
+      i++;
+    } else if (token.type == slex::TokenType::REDIRECT) {
+      if (i + 1 >= tokens.size() ||
+          tokens[i + 1].type != slex::TokenType::WORD) {
+        throw SyntaxError(tokens, i + 1);
+      }
+      this->redirects.push_back(
+          Redirect{token.op, token.fd, arena->copy(tokens[i + 1].text)});
+      i += 2;
+    } else {
+      break;
+    }
+  }
+  if (this->words.empty() && this->redirects.empty()) {
+    throw SyntaxError(tokens, i);
+  }
+  this->commands.push_back(
+      Command{arena->copy(std::span<const std::string_view>(this->words)),
+              arena->copy(std::span<const Redirect>(this->redirects))});
+  return i;
+}
+
+#endif  // SRC_PARSER_CPP_
@@ -0,0 +1,98 @@
+#ifndef SRC_PARSER_H_
+#define SRC_PARSER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "./arena.hpp"
+#include "./lexer.hpp"
+
+namespace shell::parser {
+
+// Parsed ASTs kept around for lines that come back.
+constexpr size_t kParseCacheSize = 64;
+
+struct Redirect {
+  shell::lexer::RedirectOp op;
+  // -1 when the operator's default fd applies.
+  int fd;
+  std::string_view target;
+};
+
+// A simple command: its argument vector (argv[0] is the command) and its
+// redirections in the order they were written.
+struct Command {
+  std::span<const std::string_view> argv;
+  std::span<const Redirect> redirects;
+};
+
+// How a pipeline relates to the one after it.
+enum class Connector { SEQUENCE, AND, OR, BACKGROUND };
+
+struct Pipeline {
+  std::span<const Command> commands;
+  Connector connector;
+  // Whether it was prefixed with the `time` keyword.
+  bool timed;
+};
+
+// A whole command line: pipelines joined by `;`, `&&`, `||` and `&`.
+struct Program {
+  std::span<const Pipeline> pipelines;
+};
+
+// Recursive-descent parser for
+//
+//   program  := pipeline ((';' | '&' | '&&' | '||') pipeline)* [';' | '&']
+//   pipeline := ['time'] command ('|' command)*
+//   command  := (WORD | REDIRECT WORD)+
+//
+// Every node and word of the resulting AST lives in an arena owned by the
+// parser. ASTs are cached by the hash of their line, least recently used
+// first out, so running the same line again (history replays, loops in
+// scripts) skips lexing and parsing altogether.
+class Parser {
+ public:
+  Parser();
+  Parser(const Parser&) = delete;
+  Parser& operator=(const Parser&) = delete;
+  // Parses `line`, throwing std::runtime_error on a syntax error. The AST
+  // stays valid at least until the next call.
+  const Program& parse(std::string_view line);
+  // Number of calls answered from the cache.
+  size_t hits() const;
+
+ private:
+  struct Parsed {
+    std::string line;
+    shell::arena::Arena arena;
+    Program program;
+  };
+  shell::lexer::Lexer lexer;
+  std::list<std::unique_ptr<Parsed>> entries;
+  std::unordered_map<uint64_t, std::list<std::unique_ptr<Parsed>>::iterator>
+      index;
+  size_t hit_count;
+  // Scratch space the nodes are gathered in before being copied to the
+  // arena.
+  std::vector<std::string_view> words;
+  std::vector<Redirect> redirects;
+  std::vector<Command> commands;
+  std::vector<Pipeline> pipelines;
+  void build(std::span<const shell::lexer::Token> tokens, Parsed* parsed);
+  size_t parsePipeline(std::span<const shell::lexer::Token> tokens, size_t i,
+                       shell::arena::Arena* arena);
+  size_t parseCommand(std::span<const shell::lexer::Token> tokens, size_t i,
+                      shell::arena::Arena* arena);
+};
+
+}  // namespace shell::parser
+
+#endif  // SRC_PARSER_H_
@@ -0,0 +1,270 @@
+#ifndef SRC_PATH_CACHE_CPP_
+#define SRC_PATH_CACHE_CPP_
+
+#include "./path_cache.hpp"
+
+#include <fcntl.h>
+#include <spdlog/spdlog.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./utils.hpp"
+
+namespace fs = std::filesystem;
+namespace spc = shell::path_cache;
+
+namespace {
+constexpr size_t kInitialCapacity = 64;
+// Entries added with `hash -p` don't belong to any PATH directory.
+constexpr size_t kNoDir = std::numeric_limits<size_t>::max();
+
+bool SameMtime(const timespec& a, const timespec& b) {
+  return a.tv_sec == b.tv_sec && a.tv_nsec == b.tv_nsec;
+}
+}  // namespace
+
+spc::PathCache* spc::GLOBAL_COMMAND_CACHE = nullptr;
+
+spc::PathCache::PathCache() : slots(kInitialCapacity), count(0) {}
+
+spc::PathCache::~PathCache() { this->closeDirs(); }
+
+void spc::PathCache::closeDirs() {
+  for (auto& dir : this->dirs) {
+    if (dir.fd != -1) close(dir.fd);
+  }
+  this->dirs.clear();
+}
+
+size_t spc::PathCache::find(const std::string& command) const {
+  size_t mask = this->slots.size() - 1;
+  size_t i = std::hash<std::string>{}(command) & mask;
+  while (this->slots[i].used && this->slots[i].name != command) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void spc::PathCache::grow() {
+  std::vector<Slot> old(this->slots.size() * 2);
+  std::swap(old, this->slots);
+  this->count = 0;
+  for (auto& slot : old) {
+    if (slot.used) this->insert(std::move(slot));
+  }
+}
+
+void spc::PathCache::insert(Slot slot) {
+  // Keep the load factor under 3/4 so probe sequences stay short.
+  if ((this->count + 1) * 4 > this->slots.size() * 3) {
+    this->grow();
+  }
+  size_t i = this->find(slot.name);
+  if (!this->slots[i].used) this->count++;
+  slot.used = true;
+  this->slots[i] = std::move(slot);
+}
+
+bool spc::PathCache::forget(const std::string& command) {
+  std::lock_guard lock(this->mutex);
+  size_t mask = this->slots.size() - 1;
+  size_t i = this->find(command);
+  if (!this->slots[i].used) return false;
+  this->slots[i] = Slot{};
+  this->count--;
+  // Backward-shift the rest of the cluster so lookups never stop early at the
+  // hole we just made.
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (!this->slots[j].used) break;
+    size_t home = std::hash<std::string>{}(this->slots[j].name) & mask;
+    // Move slots[j] into the hole when its home isn't cyclically in (i, j].
+    bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+    if (movable) {
+      this->slots[i] = std::move(this->slots[j]);
+      this->slots[j] = Slot{};
+      i = j;
+    }
+  }
+  return true;
+}
+
+void spc::PathCache::clear() {
+  std::lock_guard lock(this->mutex);
+  this->reset();
+}
+
+void spc::PathCache::reset() {
+  this->slots.assign(kInitialCapacity, Slot{});
+  this->count = 0;
+}
+
+size_t spc::PathCache::size() const {
+  std::lock_guard lock(this->mutex);
+  return this->count;
+}
+
+std::vector<spc::Entry> spc::PathCache::entries() const {
+  std::lock_guard lock(this->mutex);
+  std::vector<Entry> res;
+  res.reserve(this->count);
+  for (const auto& slot : this->slots) {
+    if (slot.used) res.push_back(Entry{slot.name, slot.path, slot.hits});
+  }
+  return res;
+}
+
+// Drops every entry found in PATH directory `dir` or later, since a new file
+// in `dir` may shadow any of them.
+void spc::PathCache::dropFrom(size_t dir) {
+  std::vector<Slot> old(this->slots.size());
+  std::swap(old, this->slots);
+  this->count = 0;
+  for (auto& slot : old) {
+    if (slot.used && (slot.dir == kNoDir || slot.dir < dir)) {
+      this->insert(std::move(slot));
+    }
+  }
+}
+
+void spc::PathCache::validate() {
+  char* val = getenv("PATH");
+  std::string path_env = val == NULL ? std::string("") : std::string(val);
+  if (path_env != this->path_env || this->dirs.empty()) {
+    SPDLOG_DEBUG("PATH changed, clearing command cache.");
+    this->path_env = path_env;
+    this->closeDirs();
+    for (auto& loc : GetPathEntries()) {
+      this->dirs.push_back(Dir{loc, -1, 0, {}, false});
+    }
+    this->reset();
+  }
+  for (size_t i = 0; i < this->dirs.size(); i++) {
+    Dir& dir = this->dirs[i];
+    struct stat s;
+    bool exists = stat(dir.path.c_str(), &s) == 0;
+    timespec mtime = exists ? s.st_mtim : timespec{};
+    ino_t ino = exists ? s.st_ino : 0;
+    if (exists == dir.exists && ino == dir.ino && SameMtime(mtime, dir.mtime)) {
+      continue;
+    }
+    SPDLOG_DEBUG("{} changed, dropping cached commands from it on.",
+                  dir.path);
+    if (ino != dir.ino || !exists) {
+      // Replaced or removed, so the old handle points at the wrong inode.
+      if (dir.fd != -1) close(dir.fd);
+      dir.fd = exists && S_ISDIR(s.st_mode)
+                   ? open(dir.path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC)
+                   : -1;
+    }
+    dir.exists = exists;
+    dir.ino = ino;
+    dir.mtime = mtime;
+    this->dropFrom(i);
+  }
+}
+
+std::string spc::PathCache::resolve(size_t dir,
+                                    const std::string& command) const {
+  const Dir& d = this->dirs[dir];
+  if (d.fd == -1) {
+    // Not a directory, e.g., PATH naming an executable directly.
+    return FindInPathEntry(d.path, command);
+  }
+  if (command.empty() || command.find('/') != std::string::npos ||
+      !IsExecutableFile(d.fd, command.c_str())) {
+    return "";
+  }
+  return (fs::path(d.path) / command).string();
+}
+
+std::string spc::PathCache::lookup(const std::string& command) {
+  std::lock_guard lock(this->mutex);
+  this->validate();
+  size_t i = this->find(command);
+  if (this->slots[i].used) {
+    this->slots[i].hits++;
+    return this->slots[i].path;
+  }
+  for (size_t dir = 0; dir < this->dirs.size(); dir++) {
+    if (!this->dirs[dir].exists) continue;
+    std::string path = this->resolve(dir, command);
+    if (!path.empty()) {
+      this->insert(Slot{command, path, dir, 1, true});
+      return path;
+    }
+  }
+  return "";
+}
+
+void spc::PathCache::remember(const std::string& command,
+                              const std::string& path) {
+  std::lock_guard lock(this->mutex);
+  this->validate();
+  this->insert(Slot{command, path, kNoDir, 0, true});
+}
+
+std::string spc::HashCommand(std::span<const std::string_view> args) {
+  if (GLOBAL_COMMAND_CACHE == nullptr) {
+    throw std::runtime_error("Must configure `GLOBAL_COMMAND_CACHE` variable.");
+  }
+  bool reusable = false;
+  std::string res = "";
+  for (size_t i = 0; i < args.size(); i++) {
+    std::string arg{args[i]};
+    if (arg == "-r") {
+      GLOBAL_COMMAND_CACHE->clear();
+    } else if (arg == "-l") {
+      reusable = true;
+    } else if (arg == "-d") {
+      if (i + 1 >= args.size()) {
+        throw std::runtime_error("hash: -d: option requires an argument");
+      }
+      std::string name{args[++i]};
+      if (!GLOBAL_COMMAND_CACHE->forget(name)) {
+        throw std::runtime_error("hash: " + name + ": not found");
+      }
+    } else if (arg == "-p") {
+      if (i + 2 >= args.size()) {
+        throw std::runtime_error("hash: -p: option requires an argument");
+      }
+      std::string path{args[++i]};
+      GLOBAL_COMMAND_CACHE->remember(std::string(args[++i]), path);
+    } else if (GLOBAL_COMMAND_CACHE->lookup(arg).empty()) {
+      throw std::runtime_error("hash: " + arg + ": not found");
+    }
+  }
+  if (!args.empty() && !reusable) {
+    return res;
+  }
+  auto entries = GLOBAL_COMMAND_CACHE->entries();
+  if (entries.empty()) {
+    return "hash: hash table empty\n";
+  }
+  if (!reusable) {
+    res += "hits\tcommand\n";
+  }
+  for (const auto& entry : entries) {
+    if (reusable) {
+      res += "builtin hash -p " + entry.path + " " + entry.name + '\n';
+    } else {
+      std::string hits = std::to_string(entry.hits);
+      res += std::string(hits.size() < 4 ? 4 - hits.size() : 0, ' ') + hits +
+             '\t' + entry.path + '\n';
+    }
+  }
+  return res;
+}
+
+#endif  // SRC_PATH_CACHE_CPP_
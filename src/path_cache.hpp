@@ -0,0 +1,86 @@
+#ifndef SRC_PATH_CACHE_H_
+#define SRC_PATH_CACHE_H_
+
+#include <sys/types.h>
+#include <time.h>
+
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace shell::path_cache {
+
+// Entry of the cache as reported by `hash`.
+struct Entry {
+  std::string name;
+  std::string path;
+  size_t hits;
+};
+
+// bash-style `hash` table remembering where each command was found in PATH.
+// It's an open-addressing (linear probing) map filled on first lookup. Entries
+// are dropped when PATH changes or when the mtime of a PATH directory changes,
+// in which case only entries that directory could now shadow are forgotten.
+// Misses are resolved with one faccessat(2) per PATH directory against handles
+// kept open across lookups. All public methods are thread-safe.
+class PathCache {
+ public:
+  PathCache();
+  ~PathCache();
+  PathCache(const PathCache&) = delete;
+  PathCache& operator=(const PathCache&) = delete;
+  // Returns the full path of `command`, resolving it through PATH on a miss.
+  // Returns an empty string when it can't be found. Misses aren't cached.
+  std::string lookup(const std::string& command);
+  // Remembers `path` for `command` without searching PATH (`hash -p`).
+  void remember(const std::string& command, const std::string& path);
+  // Forgets `command`. Returns whether it was cached.
+  bool forget(const std::string& command);
+  void clear();
+  size_t size() const;
+  std::vector<Entry> entries() const;
+
+ private:
+  struct Slot {
+    std::string name;
+    std::string path;
+    // Index into `dirs` of the PATH entry the command was found in.
+    size_t dir;
+    size_t hits;
+    bool used;
+  };
+  struct Dir {
+    std::string path;
+    // O_PATH handle to the directory, or -1 when it isn't a directory.
+    int fd;
+    ino_t ino;
+    timespec mtime;
+    bool exists;
+  };
+  mutable std::mutex mutex;
+  std::vector<Slot> slots;
+  size_t count;
+  std::string path_env;
+  std::vector<Dir> dirs;
+  size_t find(const std::string& command) const;
+  void insert(Slot slot);
+  void grow();
+  void validate();
+  void dropFrom(size_t dir);
+  void closeDirs();
+  void reset();
+  std::string resolve(size_t dir, const std::string& command) const;
+};
+
+extern PathCache* GLOBAL_COMMAND_CACHE;
+
+// Implements the `hash` builtin: no args lists the table with hit counts,
+// `-r` empties it, `-l` lists it in reusable form, `-d name` forgets a command,
+// `-p path name` remembers a path, and `name...` looks commands up.
+std::string HashCommand(std::span<const std::string_view> args);
+
+}  // namespace shell::path_cache
+
+#endif  // SRC_PATH_CACHE_H_
@@ -0,0 +1,264 @@
+#ifndef SRC_PATH_INDEX_CPP_
+#define SRC_PATH_INDEX_CPP_
+
+#include "./path_index.hpp"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spdlog/spdlog.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "./path_cache.hpp"
+#include "./trie.hpp"
+#include "./utils.hpp"
+
+namespace fs = std::filesystem;
+namespace spc = shell::path_cache;
+namespace spi = shell::path_index;
+
+namespace {
+constexpr size_t kMaxThreads = 4;
+constexpr size_t kBatchSize = 256;
+constexpr uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_ATTRIB | IN_CLOSE_WRITE |
+                                IN_ONLYDIR;
+
+bool IsExecutableMode(mode_t mode) {
+  return S_ISREG(mode) && (mode & (S_IXUSR | S_IXGRP | S_IXOTH));
+}
+
+// Calls `visit` with the name of every executable the PATH entry `loc`
+// provides, until it returns false.
+template <typename F>
+void ForEachExecutable(const std::string& loc, F visit) {
+  struct stat s;
+  if (stat(loc.c_str(), &s) == -1) {
+    return;
+  } else if (S_ISREG(s.st_mode)) {
+    if (IsExecutableMode(s.st_mode)) {
+      visit(fs::path(loc).filename().string());
+    }
+    return;
+  } else if (!S_ISDIR(s.st_mode)) {
+    return;
+  }
+  DIR* dir = opendir(loc.c_str());
+  if (dir == nullptr) return;
+  int dir_fd = dirfd(dir);
+  while (dirent* entry = readdir(dir)) {
+    if (entry->d_type != DT_REG && entry->d_type != DT_LNK &&
+        entry->d_type != DT_UNKNOWN) {
+      continue;
+    }
+    struct stat entry_stat;
+    if (fstatat(dir_fd, entry->d_name, &entry_stat, 0) == 0 &&
+        IsExecutableMode(entry_stat.st_mode) && !visit(entry->d_name)) {
+      break;
+    }
+  }
+  closedir(dir);
+}
+}  // namespace
+
+spi::PathIndexer::PathIndexer(size_t threads)
+    : threads(threads),
+      next_dir(0),
+      remaining(0),
+      count(0),
+      stop(false),
+      trie(nullptr) {
+  if (this->threads == 0) {
+    this->threads =
+        std::clamp<size_t>(std::thread::hardware_concurrency(), 1, kMaxThreads);
+  }
+}
+
+spi::PathIndexer::~PathIndexer() {
+  this->stop = true;
+  this->wait();
+}
+
+void spi::PathIndexer::start(Trie* trie, const std::vector<std::string>& dirs) {
+  this->wait();
+  this->trie = trie;
+  this->dirs = dirs;
+  this->next_dir = 0;
+  this->remaining = dirs.size();
+  size_t threads = std::min(this->threads, dirs.size());
+  for (size_t i = 0; i < threads; i++) {
+    this->workers.emplace_back(&PathIndexer::work, this);
+  }
+}
+
+void spi::PathIndexer::wait() {
+  for (auto& worker : this->workers) {
+    worker.join();
+  }
+  this->workers.clear();
+}
+
+bool spi::PathIndexer::done() const { return this->remaining == 0; }
+
+size_t spi::PathIndexer::indexed() const { return this->count; }
+
+void spi::PathIndexer::work() {
+  std::vector<std::string> batch;
+  batch.reserve(kBatchSize);
+  while (!this->stop) {
+    size_t i = this->next_dir++;
+    if (i >= this->dirs.size()) break;
+    this->indexEntry(this->dirs[i], &batch);
+    this->flush(&batch);
+    this->remaining--;
+  }
+}
+
+void spi::PathIndexer::flush(std::vector<std::string>* batch) {
+  if (batch->empty()) return;
+  this->trie->insertAll(*batch);
+  this->count += batch->size();
+  batch->clear();
+}
+
+void spi::PathIndexer::indexEntry(const std::string& loc,
+                                  std::vector<std::string>* batch) {
+  ForEachExecutable(loc, [this, batch](std::string name) {
+    if (this->stop) return false;
+    batch->push_back(std::move(name));
+    if (batch->size() >= kBatchSize) {
+      this->flush(batch);
+    }
+    return true;
+  });
+  SPDLOG_DEBUG("Indexed PATH entry {}.", loc);
+}
+
+spi::PathWatcher::PathWatcher(Trie* trie, spc::PathCache* cache,
+                              std::unordered_set<std::string> pinned)
+    : trie(trie),
+      cache(cache),
+      pinned(std::move(pinned)),
+      inotify_fd(-1),
+      stop_fd(-1) {}
+
+spi::PathWatcher::~PathWatcher() { this->stop(); }
+
+bool spi::PathWatcher::start(const std::vector<std::string>& dirs) {
+  this->stop();
+  this->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  this->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (this->inotify_fd == -1 || this->stop_fd == -1) {
+    SPDLOG_DEBUG("inotify unavailable, PATH won't be watched.");
+    this->stop();
+    return false;
+  }
+  this->dirs = dirs;
+  for (const auto& dir : dirs) {
+    int wd = inotify_add_watch(this->inotify_fd, dir.c_str(), kWatchMask);
+    if (wd != -1) {
+      this->watches[wd] = dir;
+    }
+  }
+  this->thread = std::thread(&PathWatcher::run, this);
+  return true;
+}
+
+void spi::PathWatcher::stop() {
+  if (this->thread.joinable()) {
+    uint64_t one = 1;
+    write(this->stop_fd, &one, sizeof(one));
+    this->thread.join();
+  }
+  if (this->inotify_fd != -1) close(this->inotify_fd);
+  if (this->stop_fd != -1) close(this->stop_fd);
+  this->inotify_fd = -1;
+  this->stop_fd = -1;
+  this->watches.clear();
+}
+
+void spi::PathWatcher::run() {
+  alignas(inotify_event) char buffer[4096];
+  pollfd fds[2] = {{this->inotify_fd, POLLIN, 0}, {this->stop_fd, POLLIN, 0}};
+  while (true) {
+    if (poll(fds, 2, -1) == -1) {
+      if (errno == EINTR) continue;
+      return;
+    }
+    if (fds[1].revents) return;
+    ssize_t bytes;
+    while ((bytes = read(this->inotify_fd, buffer, sizeof(buffer))) > 0) {
+      for (char* p = buffer; p < buffer + bytes;) {
+        auto* event = reinterpret_cast<inotify_event*>(p);
+        p += sizeof(inotify_event) + event->len;
+        if (event->mask & IN_Q_OVERFLOW) {
+          this->rescan();
+          continue;
+        }
+        auto dir = this->watches.find(event->wd);
+        if (event->len == 0 || dir == this->watches.end()) continue;
+        this->handle(dir->second, event->name);
+      }
+    }
+  }
+}
+
+void spi::PathWatcher::rescan() {
+  SPDLOG_DEBUG("inotify queue overflowed, rescanning PATH.");
+  if (this->cache != nullptr) {
+    this->cache->clear();
+  }
+  std::unordered_set<std::string> found;
+  for (const auto& loc : this->dirs) {
+    ForEachExecutable(loc, [&found](std::string name) {
+      found.insert(std::move(name));
+      return true;
+    });
+  }
+  // An empty prefix matches nothing, so go through the words by their first
+  // character.
+  for (int c = 1; c < 256; c++) {
+    std::string first(1, static_cast<char>(c));
+    for (const auto& word : this->trie->getWords(first)) {
+      if (!found.count(word) && !this->pinned.count(word)) {
+        this->trie->remove(word);
+      }
+    }
+  }
+  this->trie->insertAll(std::vector<std::string>(found.begin(), found.end()));
+}
+
+void spi::PathWatcher::handle(const std::string& dir, const std::string& name) {
+  // Whatever happened, a cached resolution of `name` may now be stale.
+  if (this->cache != nullptr) {
+    this->cache->forget(name);
+  }
+  std::string path = (fs::path(dir) / name).string();
+  struct stat s;
+  if (stat(path.c_str(), &s) == 0 && IsExecutableMode(s.st_mode)) {
+    SPDLOG_DEBUG("{} appeared in PATH.", path);
+    this->trie->insert(name);
+    return;
+  }
+  if (this->pinned.count(name)) return;
+  // The same name may still be provided by another PATH directory.
+  for (const auto& loc : this->dirs) {
+    if (!FindInPathEntry(loc, name).empty()) return;
+  }
+  SPDLOG_DEBUG("{} left PATH.", name);
+  this->trie->remove(name);
+}
+
+#endif  // SRC_PATH_INDEX_CPP_
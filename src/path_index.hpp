@@ -0,0 +1,86 @@
+#ifndef SRC_PATH_INDEX_H_
+#define SRC_PATH_INDEX_H_
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "./path_cache.hpp"
+#include "./trie.hpp"
+
+namespace shell::path_index {
+
+// Fills a Trie with the executables found in PATH on a small pool of
+// background threads, so the prompt doesn't wait for it. Each directory is
+// scanned by one worker, which merges what it finds into the trie in batches;
+// completion sees whatever has been merged so far.
+class PathIndexer {
+ public:
+  // `threads` of 0 picks a pool size from the hardware.
+  explicit PathIndexer(size_t threads = 0);
+  ~PathIndexer();
+  PathIndexer(const PathIndexer&) = delete;
+  PathIndexer& operator=(const PathIndexer&) = delete;
+  // Starts indexing `dirs` (PATH entries) into `trie`. Returns immediately.
+  void start(Trie* trie, const std::vector<std::string>& dirs);
+  // Blocks until every directory has been indexed.
+  void wait();
+  bool done() const;
+  // Number of executables merged into the trie so far.
+  size_t indexed() const;
+
+ private:
+  size_t threads;
+  std::vector<std::thread> workers;
+  std::vector<std::string> dirs;
+  std::atomic<size_t> next_dir;
+  std::atomic<size_t> remaining;
+  std::atomic<size_t> count;
+  std::atomic<bool> stop;
+  Trie* trie;
+  void work();
+  void indexEntry(const std::string& loc, std::vector<std::string>* batch);
+  void flush(std::vector<std::string>* batch);
+};
+
+// Keeps the completion Trie and the command-path cache in sync with PATH
+// directories through inotify(7), so executables installed, removed or
+// chmod'ed mid-session are picked up without rescanning. Runs on its own
+// thread; both structures lock internally so readline can keep completing.
+class PathWatcher {
+ public:
+  // `cache` may be null. Words in `pinned` (e.g., builtins) are never removed
+  // from the trie.
+  PathWatcher(Trie* trie, shell::path_cache::PathCache* cache,
+              std::unordered_set<std::string> pinned = {});
+  ~PathWatcher();
+  PathWatcher(const PathWatcher&) = delete;
+  PathWatcher& operator=(const PathWatcher&) = delete;
+  // Watches the directories among `dirs` (PATH entries). Returns false when
+  // inotify is unavailable.
+  bool start(const std::vector<std::string>& dirs);
+  void stop();
+  // Drops every cached resolution and resyncs the trie with the watched
+  // directories. Done on the watcher thread when the inotify queue
+  // overflows, since events were lost.
+  void rescan();
+
+ private:
+  Trie* trie;
+  shell::path_cache::PathCache* cache;
+  std::unordered_set<std::string> pinned;
+  std::vector<std::string> dirs;
+  std::unordered_map<int, std::string> watches;
+  int inotify_fd;
+  int stop_fd;
+  std::thread thread;
+  void run();
+  void handle(const std::string& dir, const std::string& name);
+};
+
+}  // namespace shell::path_index
+
+#endif  // SRC_PATH_INDEX_H_
@@ -0,0 +1,231 @@
+#ifndef SRC_PROFILE_CPP_
+#define SRC_PROFILE_CPP_
+
+#include "./profile.hpp"
+
+#include <stdio.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "./io.hpp"
+
+namespace sio = shell::io;
+namespace sprof = shell::profile;
+
+namespace {
+constexpr std::array<std::string_view, sprof::kPhaseCount> kPhaseNames = {
+    "read", "parse", "resolve", "redirect",
+    "spawn", "builtin", "wait", "pipeline"};
+// Quantiles exported as JSON, with their keys.
+constexpr std::array<std::pair<double, std::string_view>, 4> kQuantiles = {{
+    {0.5, "p50"},
+    {0.9, "p90"},
+    {0.99, "p99"},
+    {0.999, "p999"},
+}};
+
+std::atomic<bool> enabled{false};
+std::array<sprof::Histogram, sprof::kPhaseCount> histograms;
+
+std::string Micros(uint64_t nanos) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.1f", static_cast<double>(nanos) / 1000);
+  return buffer;
+}
+}  // namespace
+
+std::string_view sprof::PhaseName(Phase phase) {
+  return kPhaseNames[static_cast<size_t>(phase)];
+}
+
+sprof::Histogram::Histogram() : buckets{}, total(0), total_sum(0), maximum(0) {}
+
+size_t sprof::Histogram::BucketIndex(uint64_t value) {
+  if (value < kSubBuckets) {
+    return value;
+  }
+  int shift = std::bit_width(value) - 1 - kSubBucketBits;
+  return (shift + 1) * kSubBuckets + ((value >> shift) - kSubBuckets);
+}
+
+uint64_t sprof::Histogram::BucketLow(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int shift = index / kSubBuckets - 1;
+  return (kSubBuckets + index % kSubBuckets) << shift;
+}
+
+uint64_t sprof::Histogram::BucketHigh(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  int shift = index / kSubBuckets - 1;
+  return BucketLow(index) + ((uint64_t{1} << shift) - 1);
+}
+
+void sprof::Histogram::record(uint64_t value) {
+  this->buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  this->total.fetch_add(1, std::memory_order_relaxed);
+  this->total_sum.fetch_add(value, std::memory_order_relaxed);
+  uint64_t seen = this->maximum.load(std::memory_order_relaxed);
+  while (seen < value && !this->maximum.compare_exchange_weak(
+                             seen, value, std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t sprof::Histogram::count() const {
+  return this->total.load(std::memory_order_relaxed);
+}
+
+uint64_t sprof::Histogram::sum() const {
+  return this->total_sum.load(std::memory_order_relaxed);
+}
+
+uint64_t sprof::Histogram::max() const {
+  return this->maximum.load(std::memory_order_relaxed);
+}
+
+uint64_t sprof::Histogram::bucketCount(size_t index) const {
+  return this->buckets[index].load(std::memory_order_relaxed);
+}
+
+uint64_t sprof::Histogram::percentile(double quantile) const {
+  uint64_t count = this->count();
+  if (count == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(
+      std::ceil(std::clamp(quantile, 0.0, 1.0) * count));
+  rank = std::max<uint64_t>(rank, 1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kBuckets; i++) {
+    seen += this->bucketCount(i);
+    if (seen >= rank) {
+      return std::min(BucketHigh(i), this->max());
+    }
+  }
+  return this->max();
+}
+
+void sprof::Histogram::reset() {
+  for (auto& bucket : this->buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+  this->total.store(0, std::memory_order_relaxed);
+  this->total_sum.store(0, std::memory_order_relaxed);
+  this->maximum.store(0, std::memory_order_relaxed);
+}
+
+bool sprof::Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+void sprof::SetEnabled(bool on) { enabled.store(on, std::memory_order_relaxed); }
+
+sprof::Histogram& sprof::Get(Phase phase) {
+  return histograms[static_cast<size_t>(phase)];
+}
+
+void sprof::Reset() {
+  for (auto& histogram : histograms) {
+    histogram.reset();
+  }
+}
+
+sprof::Scope::Scope(Phase phase) : phase(phase), active(Enabled()) {
+  if (this->active) {
+    this->start = std::chrono::steady_clock::now();
+  }
+}
+
+sprof::Scope::~Scope() {
+  if (this->active) {
+    auto elapsed = std::chrono::steady_clock::now() - this->start;
+    Get(this->phase).record(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+  }
+}
+
+std::string sprof::Json() {
+  std::string res = "{\"enabled\":";
+  res += Enabled() ? "true" : "false";
+  res += ",\"unit\":\"ns\",\"phases\":{";
+  for (size_t phase = 0; phase < kPhaseCount; phase++) {
+    const Histogram& histogram = histograms[phase];
+    if (phase > 0) res += ',';
+    res += '"';
+    res += kPhaseNames[phase];
+    res += "\":{\"count\":" + std::to_string(histogram.count()) +
+           ",\"sum\":" + std::to_string(histogram.sum()) +
+           ",\"max\":" + std::to_string(histogram.max());
+    for (auto [quantile, key] : kQuantiles) {
+      res += ",\"";
+      res += key;
+      res += "\":" + std::to_string(histogram.percentile(quantile));
+    }
+    // [low, high, count] for every bucket anything fell into.
+    res += ",\"buckets\":[";
+    bool first = true;
+    for (size_t i = 0; i < kBuckets; i++) {
+      uint64_t count = histogram.bucketCount(i);
+      if (count == 0) continue;
+      if (!first) res += ',';
+      first = false;
+      res += "[" + std::to_string(Histogram::BucketLow(i)) + "," +
+             std::to_string(Histogram::BucketHigh(i)) + "," +
+             std::to_string(count) + "]";
+    }
+    res += "]}";
+  }
+  res += "}}\n";
+  return res;
+}
+
+int sprof::ProfileCommand(std::span<const std::string_view> args,
+                          sio::OutputSink* out) {
+  std::string_view command = args.empty() ? "show" : args[0];
+  if (args.size() > 1) {
+    throw std::runtime_error("profile: too many arguments");
+  }
+  if (command == "on") {
+    SetEnabled(true);
+  } else if (command == "off") {
+    SetEnabled(false);
+  } else if (command == "reset") {
+    Reset();
+  } else if (command == "json") {
+    out->write(Json());
+  } else if (command == "show") {
+    char line[128];
+    snprintf(line, sizeof(line), "%-10s %10s %12s %12s %12s\n", "phase",
+             "count", "p50 (us)", "p99 (us)", "max (us)");
+    out->write(line);
+    for (size_t phase = 0; phase < kPhaseCount; phase++) {
+      const Histogram& histogram = histograms[phase];
+      snprintf(line, sizeof(line), "%-10s %10llu %12s %12s %12s\n",
+               std::string(kPhaseNames[phase]).c_str(),
+               static_cast<unsigned long long>(histogram.count()),
+               Micros(histogram.percentile(0.5)).c_str(),
+               Micros(histogram.percentile(0.99)).c_str(),
+               Micros(histogram.max()).c_str());
+      out->write(line);
+    }
+    if (!Enabled()) {
+      out->write("profiling is off; `profile on` starts it\n");
+    }
+  } else {
+    throw std::runtime_error("profile: " + std::string(command) +
+                             ": invalid argument");
+  }
+  return 0;
+}
+
+#endif  // SRC_PROFILE_CPP_
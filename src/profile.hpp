@@ -0,0 +1,110 @@
+#ifndef SRC_PROFILE_H_
+#define SRC_PROFILE_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "./io.hpp"
+
+namespace shell::profile {
+
+// The steps a command line goes through, in order.
+enum class Phase {
+  // Waiting in readline, or reading the next line of a script.
+  READ,
+  PARSE,
+  // Looking up the command in PATH.
+  RESOLVE,
+  REDIRECT,
+  // posix_spawn(3), which forks and execs in one call.
+  SPAWN,
+  // Running a builtin in the shell.
+  BUILTIN,
+  // Waiting for a foreground job.
+  WAIT,
+  // A whole pipeline, from its first stage to its last status.
+  PIPELINE,
+};
+constexpr size_t kPhaseCount = 8;
+
+std::string_view PhaseName(Phase phase);
+
+// Log-linear buckets: values below 2^kSubBucketBits get a bucket each, and
+// every power of two above is split into 2^kSubBucketBits buckets, which
+// keeps every bucket within about 3% of its values.
+constexpr int kSubBucketBits = 5;
+constexpr size_t kSubBuckets = size_t{1} << kSubBucketBits;
+constexpr size_t kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+// Latencies in nanoseconds, recorded with relaxed atomics so that any thread
+// can record without taking a lock. Reads may see a recording half done,
+// which only skews them by that one value.
+class Histogram {
+ public:
+  Histogram();
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+  void record(uint64_t value);
+  uint64_t count() const;
+  uint64_t sum() const;
+  uint64_t max() const;
+  // Value that `quantile` (0 to 1) of the recorded values are at or below,
+  // rounded up to the top of its bucket and capped at the max; 0 when empty.
+  uint64_t percentile(double quantile) const;
+  // Recorded values in bucket `index`.
+  uint64_t bucketCount(size_t index) const;
+  void reset();
+
+  static size_t BucketIndex(uint64_t value);
+  // Smallest and largest value that falls into bucket `index`.
+  static uint64_t BucketLow(size_t index);
+  static uint64_t BucketHigh(size_t index);
+
+ private:
+  std::array<std::atomic<uint64_t>, kBuckets> buckets;
+  std::atomic<uint64_t> total;
+  std::atomic<uint64_t> total_sum;
+  std::atomic<uint64_t> maximum;
+};
+
+// Whether phases are being recorded. Costs one relaxed atomic load.
+bool Enabled();
+void SetEnabled(bool enabled);
+// The histogram `phase` is recorded into.
+Histogram& Get(Phase phase);
+void Reset();
+
+// Records how long it lives into `phase`'s histogram, if profiling was on
+// when it was created.
+class Scope {
+ public:
+  explicit Scope(Phase phase);
+  ~Scope();
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+
+ private:
+  Phase phase;
+  bool active;
+  std::chrono::steady_clock::time_point start;
+};
+
+// Every phase as a JSON object: counts, percentiles and the non-empty
+// buckets, in nanoseconds.
+std::string Json();
+
+// The `profile` builtin: `on`, `off` and `reset` switch and clear recording,
+// `json` prints every histogram as JSON, and no argument prints counts,
+// p50, p99 and max by phase.
+int ProfileCommand(std::span<const std::string_view> args,
+                   shell::io::OutputSink* out);
+
+}  // namespace shell::profile
+
+#endif  // SRC_PROFILE_H_
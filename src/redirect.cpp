@@ -0,0 +1,169 @@
+#ifndef SRC_REDIRECT_CPP_
+#define SRC_REDIRECT_CPP_
+
+#include "./redirect.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "./launcher.hpp"
+#include "./lexer.hpp"
+#include "./parser.hpp"
+
+namespace fs = std::filesystem;
+namespace launch = shell::launcher;
+namespace sparse = shell::parser;
+namespace sredir = shell::redirect;
+namespace slex = shell::lexer;
+
+namespace {
+std::runtime_error RedirectError(std::string_view target, int error) {
+  return std::runtime_error(std::string(target) + ": " + std::strerror(error));
+}
+}  // namespace
+
+sredir::FdTable::FdTable(int in_fd, int out_fd, int err_fd)
+    : fds{in_fd, out_fd, err_fd}, touched(0b111) {
+  // The shell's other fds are its own business, not the command's.
+  for (int fd = 3; fd < kMaxFd; fd++) {
+    this->fds[fd] = -1;
+  }
+}
+
+sredir::FdTable::~FdTable() {
+  for (int fd : this->owned) {
+    close(fd);
+  }
+}
+
+int sredir::FdTable::lift(int fd) {
+  if (fd >= kMaxFd) {
+    this->owned.push_back(fd);
+    return fd;
+  }
+  int high = fcntl(fd, F_DUPFD_CLOEXEC, kMaxFd);
+  int error = errno;
+  close(fd);
+  if (high == -1) {
+    throw RedirectError(std::to_string(fd), error);
+  }
+  this->owned.push_back(high);
+  return high;
+}
+
+int sredir::FdTable::open(std::string_view target, int flags) {
+  std::string path{target};
+  int fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+  if (fd == -1 && errno == ENOENT && (flags & O_CREAT)) {
+    // The shell has always created missing directories for output files;
+    // only pay for that when the open says they're missing.
+    fs::path dir = fs::path(path).parent_path();
+    std::error_code ignored;
+    if (!dir.empty() && fs::create_directories(dir, ignored)) {
+      fd = ::open(path.c_str(), flags | O_CLOEXEC, 0644);
+    } else {
+      errno = ENOENT;
+    }
+  }
+  if (fd == -1) {
+    throw RedirectError(target, errno);
+  }
+  return this->lift(fd);
+}
+
+void sredir::FdTable::apply(std::span<const sparse::Redirect> redirects) {
+  for (const auto& redirect : redirects) {
+    bool input = redirect.op == slex::RedirectOp::INPUT ||
+                 redirect.op == slex::RedirectOp::DUP_INPUT;
+    int fd = redirect.fd != -1 ? redirect.fd : (input ? 0 : 1);
+    if (fd < 0 || fd >= kMaxFd) {
+      throw RedirectError(std::to_string(fd), EBADF);
+    }
+    switch (redirect.op) {
+      case slex::RedirectOp::OUTPUT:
+      case slex::RedirectOp::APPEND:
+        this->fds[fd] = this->open(
+            redirect.target,
+            O_WRONLY | O_CREAT |
+                (redirect.op == slex::RedirectOp::APPEND ? O_APPEND
+                                                         : O_TRUNC));
+        break;
+      case slex::RedirectOp::INPUT:
+        this->fds[fd] = this->open(redirect.target, O_RDONLY);
+        break;
+      case slex::RedirectOp::ALL:
+      case slex::RedirectOp::APPEND_ALL:
+        this->fds[1] = this->open(
+            redirect.target,
+            O_WRONLY | O_CREAT |
+                (redirect.op == slex::RedirectOp::APPEND_ALL ? O_APPEND
+                                                             : O_TRUNC));
+        this->fds[2] = this->fds[1];
+        break;
+      case slex::RedirectOp::DUP_OUTPUT:
+      case slex::RedirectOp::DUP_INPUT: {
+        if (redirect.target == "-") {
+          this->fds[fd] = -1;
+          break;
+        }
+        int source = -1;
+        auto [end, error] = std::from_chars(
+            redirect.target.data(),
+            redirect.target.data() + redirect.target.size(), source);
+        if (error != std::errc() ||
+            end != redirect.target.data() + redirect.target.size() ||
+            source < 0 || source >= kMaxFd || this->fds[source] == -1) {
+          throw RedirectError(redirect.target, EBADF);
+        }
+        this->fds[fd] = this->fds[source];
+        break;
+      }
+      case slex::RedirectOp::NONE:
+        break;
+    }
+    this->touched.set(fd);
+  }
+  // The child installs the table one fd at a time, so a low shell fd that
+  // backs one entry but is itself redirected elsewhere would be overwritten
+  // before it's copied; back such entries with a copy out of the way.
+  for (int fd = 0; fd < kMaxFd; fd++) {
+    int source = this->fds[fd];
+    if (source < 0 || source >= kMaxFd || source == fd ||
+        !this->touched[source] || this->fds[source] == source) {
+      continue;
+    }
+    int high = fcntl(source, F_DUPFD_CLOEXEC, kMaxFd);
+    if (high == -1) {
+      throw RedirectError(std::to_string(source), errno);
+    }
+    this->owned.push_back(high);
+    for (int& other : this->fds) {
+      if (other == source) other = high;
+    }
+  }
+}
+
+int sredir::FdTable::get(int fd) const {
+  return fd >= 0 && fd < kMaxFd ? this->fds[fd] : -1;
+}
+
+void sredir::FdTable::install(launch::FileActions* actions) const {
+  for (int fd = 0; fd < kMaxFd; fd++) {
+    if (!this->touched[fd]) continue;
+    if (this->fds[fd] == -1) {
+      actions->close(fd);
+    } else {
+      actions->dup2(this->fds[fd], fd);
+    }
+  }
+}
+
+#endif  // SRC_REDIRECT_CPP_
@@ -0,0 +1,52 @@
+#ifndef SRC_REDIRECT_H_
+#define SRC_REDIRECT_H_
+
+#include <array>
+#include <bitset>
+#include <span>
+#include <vector>
+
+#include "./launcher.hpp"
+#include "./parser.hpp"
+
+namespace shell::redirect {
+
+// Redirections may name fds 0 through kMaxFd - 1. Everything the table opens
+// or copies lives at kMaxFd or above, so it never collides with a target.
+constexpr int kMaxFd = 10;
+
+// The fds a command runs with: which of the shell's fds backs each fd the
+// command will see. Redirections are applied left to right like a POSIX
+// shell does, so `>f 2>&1` sends both streams to f while `2>&1 >f` leaves
+// stderr on the old stdout. Each target is opened with a single open(2) and
+// `install` wires the result into a spawned child with dup2, so redirected
+// data never passes through the shell.
+class FdTable {
+ public:
+  // Starts with fds 0, 1 and 2 backed by `in_fd`, `out_fd` and `err_fd`.
+  FdTable(int in_fd, int out_fd, int err_fd);
+  // Closes the fds the table opened or copied.
+  ~FdTable();
+  FdTable(const FdTable&) = delete;
+  FdTable& operator=(const FdTable&) = delete;
+  // Applies `redirects` in order, throwing std::runtime_error with a
+  // "<target>: <reason>" message when one can't be.
+  void apply(std::span<const shell::parser::Redirect> redirects);
+  // The shell's fd backing `fd`, or -1 if it's closed.
+  int get(int fd) const;
+  // Adds the actions making the child's fds match the table.
+  void install(shell::launcher::FileActions* actions) const;
+
+ private:
+  std::array<int, kMaxFd> fds;
+  // Entries that differ from what the child would inherit anyway.
+  std::bitset<kMaxFd> touched;
+  std::vector<int> owned;
+  // Moves `fd`, which the table now owns, to kMaxFd or above.
+  int lift(int fd);
+  int open(std::string_view target, int flags);
+};
+
+}  // namespace shell::redirect
+
+#endif  // SRC_REDIRECT_H_
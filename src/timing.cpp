@@ -0,0 +1,132 @@
+#ifndef SRC_TIMING_CPP_
+#define SRC_TIMING_CPP_
+
+#include "./timing.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "./parser.hpp"
+
+namespace chrono = std::chrono;
+namespace stiming = shell::timing;
+namespace sparse = shell::parser;
+
+namespace {
+chrono::microseconds Micros(const struct timeval& time) {
+  return chrono::seconds(time.tv_sec) + chrono::microseconds(time.tv_usec);
+}
+
+std::string Seconds(chrono::nanoseconds time) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.3fs",
+           chrono::duration<double>(time).count());
+  return buffer;
+}
+
+std::string Command(const sparse::Command& command) {
+  std::string res;
+  for (auto word : command.argv) {
+    if (!res.empty()) res += ' ';
+    res.append(word);
+  }
+  return res;
+}
+
+std::string Row(const std::string& stage, const stiming::Usage& usage,
+                const std::string& command) {
+  char buffer[128];
+  snprintf(buffer, sizeof(buffer), "%-6s %9s %9s %9s %9ldk %6ld %6ld %11llu  ",
+           stage.c_str(), Seconds(usage.real).c_str(),
+           Seconds(usage.user).c_str(), Seconds(usage.sys).c_str(),
+           usage.max_rss, usage.voluntary_switches, usage.involuntary_switches,
+           static_cast<unsigned long long>(usage.written));
+  return buffer + command + '\n';
+}
+}  // namespace
+
+stiming::Usage stiming::FromRusage(const struct rusage& usage) {
+  Usage res;
+  res.user = Micros(usage.ru_utime);
+  res.sys = Micros(usage.ru_stime);
+  res.max_rss = usage.ru_maxrss;
+  res.voluntary_switches = usage.ru_nvcsw;
+  res.involuntary_switches = usage.ru_nivcsw;
+  return res;
+}
+
+void stiming::Add(Usage* total, const Usage& usage) {
+  total->real = std::max(total->real, usage.real);
+  total->user += usage.user;
+  total->sys += usage.sys;
+  total->max_rss = std::max(total->max_rss, usage.max_rss);
+  total->voluntary_switches += usage.voluntary_switches;
+  total->involuntary_switches += usage.involuntary_switches;
+  total->written += usage.written;
+}
+
+uint64_t stiming::Written(pid_t pid) {
+  std::string path = "/proc/" + std::to_string(pid) + "/io";
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    return 0;
+  }
+  char buffer[512];
+  ssize_t size = read(fd, buffer, sizeof(buffer));
+  close(fd);
+  std::string_view io{buffer, static_cast<size_t>(std::max<ssize_t>(size, 0))};
+  constexpr std::string_view kField = "wchar: ";
+  size_t at = io.find(kField);
+  uint64_t res = 0;
+  if (at != std::string_view::npos) {
+    io.remove_prefix(at + kField.size());
+    std::from_chars(io.data(), io.data() + io.size(), res);
+  }
+  return res;
+}
+
+stiming::Stopwatch::Stopwatch() : start(chrono::steady_clock::now()) {
+  getrusage(RUSAGE_THREAD, &this->usage);
+}
+
+stiming::Usage stiming::Stopwatch::elapsed() const {
+  struct rusage now;
+  getrusage(RUSAGE_THREAD, &now);
+  Usage res;
+  res.real = chrono::steady_clock::now() - this->start;
+  res.user = Micros(now.ru_utime) - Micros(this->usage.ru_utime);
+  res.sys = Micros(now.ru_stime) - Micros(this->usage.ru_stime);
+  res.max_rss = now.ru_maxrss;
+  res.voluntary_switches = now.ru_nvcsw - this->usage.ru_nvcsw;
+  res.involuntary_switches = now.ru_nivcsw - this->usage.ru_nivcsw;
+  return res;
+}
+
+std::string stiming::Report(const sparse::Pipeline& pipeline,
+                            std::span<const Usage> stages,
+                            const Usage& total) {
+  std::string res =
+      "stage       real      user       sys     maxrss   vcsw  ivcsw"
+      "     written  command\n";
+  std::string pipeline_text;
+  for (size_t i = 0; i < stages.size() && i < pipeline.commands.size(); i++) {
+    std::string command = Command(pipeline.commands[i]);
+    res += Row(std::to_string(i + 1), stages[i], command);
+    if (!pipeline_text.empty()) pipeline_text += " | ";
+    pipeline_text += command;
+  }
+  res += Row("total", total, pipeline_text);
+  return res;
+}
+
+#endif  // SRC_TIMING_CPP_
@@ -0,0 +1,60 @@
+#ifndef SRC_TIMING_H_
+#define SRC_TIMING_H_
+
+#include <sys/resource.h>
+#include <sys/types.h>
+
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "./parser.hpp"
+
+namespace shell::timing {
+
+// What a pipeline stage, or a whole pipeline, cost.
+struct Usage {
+  std::chrono::nanoseconds real{0};
+  std::chrono::microseconds user{0};
+  std::chrono::microseconds sys{0};
+  // Peak resident set in KiB.
+  long max_rss = 0;
+  long voluntary_switches = 0;
+  long involuntary_switches = 0;
+  // Bytes written to any fd.
+  uint64_t written = 0;
+};
+
+// Everything but `real` and `written`, taken from getrusage(2)/wait4(2).
+Usage FromRusage(const struct rusage& usage);
+
+// Adds `usage` into `total`. Times, switches and bytes add up, while `real`
+// and `max_rss` keep the largest since stages run side by side.
+void Add(Usage* total, const Usage& usage);
+
+// Bytes `pid` and the children it reaped wrote, as counted by the kernel in
+// /proc/<pid>/io. Still readable once the process is a zombie, so it's read
+// before reaping it; 0 when it isn't available.
+uint64_t Written(pid_t pid);
+
+// Measures what the calling thread spends, for builtins run by the shell
+// itself.
+class Stopwatch {
+ public:
+  Stopwatch();
+  // Cost since construction. `max_rss` is the shell's.
+  Usage elapsed() const;
+
+ private:
+  std::chrono::steady_clock::time_point start;
+  struct rusage usage;
+};
+
+// The table `time` prints: one row per stage of `pipeline`, then the total.
+std::string Report(const shell::parser::Pipeline& pipeline,
+                   std::span<const Usage> stages, const Usage& total);
+
+}  // namespace shell::timing
+
+#endif  // SRC_TIMING_H_
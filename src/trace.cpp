@@ -0,0 +1,111 @@
+#ifndef SRC_TRACE_CPP_
+#define SRC_TRACE_CPP_
+
+#include "./trace.hpp"
+
+#include <spdlog/async.h>
+#include <spdlog/sinks/stdout_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "./io.hpp"
+
+namespace sio = shell::io;
+namespace strace = shell::trace;
+
+namespace {
+// Lines queued for the logging thread before callers start blocking.
+constexpr size_t kQueueSize = 8192;
+// Arguments made only of these are traced without quotes.
+constexpr std::string_view kPlainChars =
+    "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+    "%+,-./:=@_";
+
+std::atomic<bool> enabled{false};
+std::once_flag setup;
+std::shared_ptr<spdlog::logger> xtrace;
+
+void Setup() {
+  spdlog::init_thread_pool(kQueueSize, 1);
+  xtrace = spdlog::create_async<spdlog::sinks::stderr_sink_mt>("xtrace");
+  xtrace->set_pattern("+ %v");
+  auto logger = spdlog::create_async<spdlog::sinks::stderr_sink_mt>("shell");
+  spdlog::set_default_logger(logger);
+  // Drain the queue before the registry goes away.
+  std::atexit(spdlog::shutdown);
+}
+
+void Quote(std::string_view arg, std::string* line) {
+  if (!arg.empty() && arg.find_first_not_of(kPlainChars) == arg.npos) {
+    line->append(arg);
+    return;
+  }
+  *line += '\'';
+  for (char c : arg) {
+    if (c == '\'') {
+      line->append("'\\''");
+    } else {
+      *line += c;
+    }
+  }
+  *line += '\'';
+}
+}  // namespace
+
+bool strace::Enabled() { return enabled.load(std::memory_order_relaxed); }
+
+void strace::SetEnabled(bool on) {
+  if (on) {
+    std::call_once(setup, Setup);
+  }
+  spdlog::set_level(on ? spdlog::level::debug : spdlog::level::info);
+  enabled.store(on, std::memory_order_relaxed);
+}
+
+void strace::Command(std::span<const std::string_view> argv) {
+  if (!Enabled()) {
+    return;
+  }
+  std::string line;
+  for (auto arg : argv) {
+    if (!line.empty()) {
+      line += ' ';
+    }
+    Quote(arg, &line);
+  }
+  xtrace->info("{}", line);
+}
+
+int strace::SetCommand(std::span<const std::string_view> args,
+                       sio::OutputSink* out) {
+  for (size_t i = 0; i < args.size(); i++) {
+    std::string_view arg = args[i];
+    bool on = !arg.empty() && arg[0] == '-';
+    if (arg == "-x" || arg == "+x") {
+      SetEnabled(on);
+    } else if (arg == "-o" || arg == "+o") {
+      if (i + 1 == args.size()) {
+        out->write(std::string("xtrace         ") + (Enabled() ? "on" : "off") +
+                   '\n');
+      } else if (args[++i] == "xtrace") {
+        SetEnabled(on);
+      } else {
+        throw std::runtime_error("set: " + std::string(args[i]) +
+                                 ": invalid option name");
+      }
+    } else {
+      throw std::runtime_error("set: " + std::string(arg) +
+                               ": invalid option");
+    }
+  }
+  return 0;
+}
+
+#endif  // SRC_TRACE_CPP_
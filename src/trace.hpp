@@ -0,0 +1,31 @@
+#ifndef SRC_TRACE_H_
+#define SRC_TRACE_H_
+
+#include <span>
+#include <string_view>
+
+#include "./io.hpp"
+
+namespace shell::trace {
+
+// Whether `set -x` is on. Costs one relaxed atomic load, so call sites check
+// it before building anything to trace.
+bool Enabled();
+// Turns tracing on or off. The first time it's turned on, trace lines and the
+// default logger are moved onto an async logger writing to stderr, so neither
+// a slow terminal nor the debug statements still compiled in (anything at or
+// above SPDLOG_ACTIVE_LEVEL) hold up the command being run. While tracing is
+// on the default logger's level is lowered to debug.
+void SetEnabled(bool enabled);
+// Logs `argv` the way bash's xtrace does, e.g. "+ echo 'a b'", if tracing is
+// on. Trace lines keep their order among themselves, but may land after
+// output the command wrote directly.
+void Command(std::span<const std::string_view> argv);
+// The `set` builtin: `-x`/`+x` and `-o xtrace`/`+o xtrace` switch tracing,
+// and `-o` alone lists the options.
+int SetCommand(std::span<const std::string_view> args,
+               shell::io::OutputSink* out);
+
+}  // namespace shell::trace
+
+#endif  // SRC_TRACE_H_
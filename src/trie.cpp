@@ -6,121 +6,357 @@
 #include <readline/readline.h>
 #include <spdlog/spdlog.h>
 
-#include <iostream>
-#include <queue>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
 #include <string>
-#include <unordered_map>
-#include <unordered_set>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-TrieNode::TrieNode(char letter) : letter(letter), isEndOfWord(false) {}
-Trie::Trie() : root(new TrieNode('\0')) {}
+namespace {
+constexpr uint32_t kNone = UINT32_MAX;
+constexpr uint32_t kRoot = 0;
+// Only compact once there's enough garbage to be worth the copy.
+constexpr size_t kMinCompactBytes = 4096;
+}  // namespace
 
-Trie::~Trie() { this->deleteTrieNode(this->root); }
+Trie::Trie() : dead_bytes(0) { this->newNode(0, 0, false); }
 
-void Trie::deleteTrieNode(TrieNode* node) {
-  if (node == nullptr) return;
-  for (auto& child : node->children) {
-    this->deleteTrieNode(child.second);
+std::string_view Trie::label(const Node& node) const {
+  return std::string_view(this->labels)
+      .substr(node.label_offset, node.label_len);
+}
+
+uint32_t Trie::newNode(uint32_t label_offset, uint32_t label_len,
+                       bool is_end) {
+  Node node{label_offset, label_len, kNone, kNone, is_end};
+  if (!this->free_nodes.empty()) {
+    uint32_t index = this->free_nodes.back();
+    this->free_nodes.pop_back();
+    this->nodes[index] = node;
+    return index;
+  }
+  this->nodes.push_back(node);
+  return this->nodes.size() - 1;
+}
+
+uint32_t Trie::findChild(uint32_t node, char c, uint32_t* prev) const {
+  uint32_t before = kNone;
+  for (uint32_t child = this->nodes[node].first_child; child != kNone;
+       child = this->nodes[child].next_sibling) {
+    char first = this->labels[this->nodes[child].label_offset];
+    if (first == c) {
+      if (prev != nullptr) *prev = before;
+      return child;
+    } else if (first > c) {
+      break;
+    }
+    before = child;
   }
-  delete node;
+  if (prev != nullptr) *prev = before;
+  return kNone;
+}
+
+void Trie::linkChild(uint32_t parent, uint32_t child) {
+  uint32_t prev;
+  this->findChild(parent, this->labels[this->nodes[child].label_offset], &prev);
+  uint32_t& link = prev == kNone ? this->nodes[parent].first_child
+                                 : this->nodes[prev].next_sibling;
+  this->nodes[child].next_sibling = link;
+  link = child;
 }
 
 void Trie::insert(const std::string& word) {
-  TrieNode* curr = this->root;
-  for (char c : word) {
-    auto& map = curr->children;
-    if (map.find(c) != map.end()) {
-      spdlog::debug("{} already exists in node {}.", c, curr->letter);
-      curr = map[c];
-    } else {
-      TrieNode* node = new TrieNode{c};
-      spdlog::debug("Adding character {} to node {}.", c, curr->letter);
-      map[c] = node;
-      curr = node;
+  std::unique_lock lock(this->mutex);
+  this->insertLocked(word);
+}
+
+void Trie::insertAll(const std::vector<std::string>& words) {
+  std::unique_lock lock(this->mutex);
+  for (const auto& word : words) {
+    this->insertLocked(word);
+  }
+}
+
+void Trie::insertLocked(std::string_view word) {
+  uint32_t curr = kRoot;
+  size_t i = 0;
+  while (i < word.size()) {
+    uint32_t child = this->findChild(curr, word[i]);
+    if (child == kNone) {
+      SPDLOG_DEBUG("Adding \"{}\" under node {}.", word.substr(i), curr);
+      uint32_t offset = this->labels.size();
+      this->labels.append(word.substr(i));
+      uint32_t leaf = this->newNode(offset, word.size() - i, true);
+      this->linkChild(curr, leaf);
+      return;
+    }
+    std::string_view edge = this->label(this->nodes[child]);
+    size_t k = 1;
+    while (k < edge.size() && i + k < word.size() && edge[k] == word[i + k]) {
+      k++;
+    }
+    if (k < edge.size()) {
+      // Split the edge: `child` keeps the shared part and the rest moves into
+      // a new node that inherits its children.
+      SPDLOG_DEBUG("Splitting \"{}\" after {} characters.", edge, k);
+      const Node old = this->nodes[child];
+      uint32_t rest =
+          this->newNode(old.label_offset + k, old.label_len - k, old.is_end);
+      this->nodes[rest].first_child = old.first_child;
+      this->nodes[child].first_child = rest;
+      this->nodes[child].label_len = k;
+      this->nodes[child].is_end = false;
     }
+    curr = child;
+    i += k;
   }
-  curr->isEndOfWord = true;
+  this->nodes[curr].is_end = true;
 }
 
-bool Trie::contains(const std::string& word) {
-  TrieNode* curr = this->root;
-  for (char c : word) {
-    auto& map = curr->children;
-    if (map.find(c) != map.end()) {
-      spdlog::debug("trie contains {}.", c);
-      curr = map[c];
-    } else {
+bool Trie::descend(std::string_view prefix, uint32_t* node,
+                   uint32_t* matched) const {
+  uint32_t curr = kRoot;
+  *node = kRoot;
+  *matched = 0;
+  size_t i = 0;
+  while (i < prefix.size()) {
+    uint32_t child = this->findChild(curr, prefix[i]);
+    if (child == kNone) return false;
+    std::string_view edge = this->label(this->nodes[child]);
+    size_t k = 1;
+    while (k < edge.size() && i + k < prefix.size() &&
+           edge[k] == prefix[i + k]) {
+      k++;
+    }
+    if (i + k == prefix.size()) {
+      *node = child;
+      *matched = k;
+      return true;
+    } else if (k < edge.size()) {
       return false;
     }
+    curr = child;
+    i += k;
   }
-  if (curr->isEndOfWord) {
-    spdlog::debug("trie contains {}.", word);
-  } else {
-    spdlog::debug("trie has {}, but it isn't flagged.", word);
+  return true;
+}
+
+bool Trie::remove(const std::string& word) {
+  std::unique_lock lock(this->mutex);
+  std::vector<uint32_t> path = {kRoot};
+  size_t i = 0;
+  while (i < word.size()) {
+    uint32_t child = this->findChild(path.back(), word[i]);
+    if (child == kNone) return false;
+    std::string_view edge = this->label(this->nodes[child]);
+    if (std::string_view(word).substr(i, edge.size()) != edge) return false;
+    i += edge.size();
+    path.push_back(child);
+  }
+  if (!this->nodes[path.back()].is_end) return false;
+  this->nodes[path.back()].is_end = false;
+  // Walk back up, unlinking nodes that no longer lead to any word.
+  while (path.size() > 1) {
+    uint32_t node = path.back();
+    if (this->nodes[node].is_end || this->nodes[node].first_child != kNone) {
+      break;
+    }
+    uint32_t parent = path[path.size() - 2];
+    uint32_t prev;
+    this->findChild(parent, this->labels[this->nodes[node].label_offset],
+                    &prev);
+    uint32_t& link = prev == kNone ? this->nodes[parent].first_child
+                                   : this->nodes[prev].next_sibling;
+    link = this->nodes[node].next_sibling;
+    this->dead_bytes += this->nodes[node].label_len;
+    this->free_nodes.push_back(node);
+    path.pop_back();
+  }
+  // Keep the tree compressed: a non-word node with one child absorbs it.
+  uint32_t node = path.back();
+  uint32_t child = this->nodes[node].first_child;
+  if (node != kRoot && !this->nodes[node].is_end && child != kNone &&
+      this->nodes[child].next_sibling == kNone) {
+    Node& parent = this->nodes[node];
+    const Node& only = this->nodes[child];
+    if (parent.label_offset + parent.label_len != only.label_offset) {
+      // Labels aren't adjacent in the pool, so store the joined label anew.
+      std::string joined{this->label(parent)};
+      joined += this->label(only);
+      parent.label_offset = this->labels.size();
+      this->labels += joined;
+      this->dead_bytes += joined.size();
+    }
+    parent.label_len += only.label_len;
+    parent.is_end = only.is_end;
+    parent.first_child = only.first_child;
+    this->free_nodes.push_back(child);
   }
-  return curr->isEndOfWord;
+  if (this->dead_bytes > kMinCompactBytes &&
+      this->dead_bytes * 2 > this->labels.size()) {
+    this->compact();
+  }
+  return true;
+}
+
+void Trie::compact() {
+  SPDLOG_DEBUG("Compacting trie labels, {} of {} bytes dead.",
+               this->dead_bytes, this->labels.size());
+  std::string compacted;
+  compacted.reserve(this->labels.size() - this->dead_bytes);
+  std::vector<uint32_t> stack = {kRoot};
+  while (!stack.empty()) {
+    Node& node = this->nodes[stack.back()];
+    stack.pop_back();
+    uint32_t offset = compacted.size();
+    compacted.append(this->labels, node.label_offset, node.label_len);
+    node.label_offset = offset;
+    for (uint32_t child = node.first_child; child != kNone;
+         child = this->nodes[child].next_sibling) {
+      stack.push_back(child);
+    }
+  }
+  this->labels.swap(compacted);
+  this->dead_bytes = 0;
+}
+
+bool Trie::contains(const std::string& word) {
+  std::shared_lock lock(this->mutex);
+  uint32_t node;
+  uint32_t matched;
+  if (!this->descend(word, &node, &matched)) {
+    return false;
+  }
+  const Node& n = this->nodes[node];
+  bool found = matched == n.label_len && n.is_end;
+  SPDLOG_DEBUG("trie {} {}.", found ? "contains" : "doesn't contain", word);
+  return found;
 }
 
 int Trie::size() {
+  std::shared_lock lock(this->mutex);
   int count = 0;
-  std::queue<TrieNode*> queue;
-  queue.push(this->root);
-  while (!queue.empty()) {
-    TrieNode* curr = queue.front();
-    queue.pop();
-    count++;
-    for (auto& child : curr->children) {
-      queue.push(child.second);
+  std::vector<uint32_t> stack = {kRoot};
+  while (!stack.empty()) {
+    const Node& node = this->nodes[stack.back()];
+    stack.pop_back();
+    count += node.label_len;
+    for (uint32_t child = node.first_child; child != kNone;
+         child = this->nodes[child].next_sibling) {
+      stack.push_back(child);
     }
   }
-  // Don't want to include count of root node.
-  count--;
   return count;
 }
 
-std::vector<std::string> Trie::getWords(const std::string& prefix) {
-  std::vector<std::string> words;
-  TrieNode* curr = this->root;
-  for (auto c : prefix) {
-    if (curr->children.find(c) != curr->children.end()) {
-      curr = curr->children[c];
-    } else {
-      return words;
-    }
-  }
+size_t Trie::labelBytes() {
+  std::shared_lock lock(this->mutex);
+  return this->labels.size();
+}
 
-  std::queue<std::pair<TrieNode*, std::string>> queue;
-  if (curr != this->root) {
-    queue.emplace(curr, prefix);
+size_t Trie::forEachWord(const std::string& prefix, size_t limit,
+                         const std::function<bool(std::string_view)>& visit) {
+  std::shared_lock lock(this->mutex);
+  uint32_t node;
+  uint32_t matched;
+  if (prefix.empty() || limit == 0 ||
+      !this->descend(prefix, &node, &matched)) {
+    return 0;
   }
-  while (!queue.empty()) {
-    auto [node, word] = queue.front();
-    queue.pop();
-    if (node->isEndOfWord) {
-      words.push_back(word);
+  std::string word = prefix;
+  word.append(this->label(this->nodes[node]).substr(matched));
+  // Depth-first walk with an explicit stack of (node, length of `word` before
+  // the node's label). Children are pushed in reverse so the smallest is
+  // visited first.
+  std::vector<std::pair<uint32_t, size_t>> stack;
+  std::vector<uint32_t> children;
+  size_t visited = 0;
+  uint32_t curr = node;
+  while (true) {
+    if (this->nodes[curr].is_end) {
+      visited++;
+      if (!visit(word) || visited >= limit) break;
+    }
+    children.clear();
+    for (uint32_t child = this->nodes[curr].first_child; child != kNone;
+         child = this->nodes[child].next_sibling) {
+      children.push_back(child);
     }
-    for (auto& child : node->children) {
-      queue.emplace(child.second, word + child.first);
+    for (auto it = children.rbegin(); it != children.rend(); it++) {
+      stack.emplace_back(*it, word.size());
     }
+    if (stack.empty()) break;
+    auto [next, len] = stack.back();
+    stack.pop_back();
+    word.resize(len);
+    word.append(this->label(this->nodes[next]));
+    curr = next;
   }
+  return visited;
+}
+
+std::vector<std::string> Trie::getWords(const std::string& prefix,
+                                        size_t limit) {
+  std::vector<std::string> words;
+  this->forEachWord(prefix, limit, [&words](std::string_view word) {
+    words.emplace_back(word);
+    return true;
+  });
   return words;
 }
 
+std::string Trie::longestCommonPrefix(const std::string& prefix) {
+  std::shared_lock lock(this->mutex);
+  uint32_t node;
+  uint32_t matched;
+  if (!this->descend(prefix, &node, &matched)) {
+    return prefix;
+  }
+  std::string res = prefix;
+  res.append(this->label(this->nodes[node]).substr(matched));
+  while (!this->nodes[node].is_end) {
+    uint32_t child = this->nodes[node].first_child;
+    if (child == kNone || this->nodes[child].next_sibling != kNone) break;
+    res.append(this->label(this->nodes[child]));
+    node = child;
+  }
+  return res;
+}
+
 Trie* GLOBAL_TRIE = nullptr;
-char* AutoComplete(const char* text, int state) {
-  static std::vector<std::string> matches;
-  static size_t match_index = 0;
+char** AutoComplete(const char* text, int, int) {
   if (GLOBAL_TRIE == nullptr) {
     throw std::runtime_error("Must configure `GLOBAL_TRIE` variable.");
   }
-
-  if (state == 0) {
-    matches = GLOBAL_TRIE->getWords(text);
-    match_index = 0;
+  // Never fall back to readline's filename completion.
+  rl_attempted_completion_over = 1;
+  std::vector<char*> matches = {nullptr};
+  GLOBAL_TRIE->forEachWord(text, kMaxCompletions,
+                           [&matches](std::string_view word) {
+                             matches.push_back(strndup(word.data(), word.size()));
+                             return true;
+                           });
+  if (matches.size() == 1) {
+    return nullptr;
+  }
+  // readline wants the text to substitute first, then the matches, unless
+  // there's only one match, which then is the substitution.
+  if (matches.size() == 2) {
+    matches.erase(matches.begin());
+  } else {
+    matches[0] = strdup(GLOBAL_TRIE->longestCommonPrefix(text).c_str());
   }
-  return (match_index < matches.size()) ? strdup(matches[match_index++].c_str())
-                                        : reinterpret_cast<char*>(NULL);
+  matches.push_back(nullptr);
+  char** res = static_cast<char**>(malloc(matches.size() * sizeof(char*)));
+  std::copy(matches.begin(), matches.end(), res);
+  return res;
 }
 
 #endif  // SRC_TRIE_CPP_
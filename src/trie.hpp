@@ -1,33 +1,90 @@
 #ifndef SRC_TRIE_H_
 #define SRC_TRIE_H_
 
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <shared_mutex>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
-struct TrieNode {
-  const char letter;
-  std::unordered_map<char, TrieNode*> children;
-  bool isEndOfWord;
-
-  explicit TrieNode(char letter);
-};
-
+// Compressed (radix) trie: each node holds a run of characters instead of a
+// single one, and all nodes live in one contiguous array with their labels in
+// a shared character pool, so indexing PATH costs a handful of allocations
+// instead of one per character. Children are kept sorted by their first
+// character, which makes traversal order lexicographic.
+//
+// Safe to use from several threads: writers take the lock exclusively and
+// readers share it, so completion can run while PATH is still being indexed.
 class Trie {
  private:
-  TrieNode* root;
-  void deleteTrieNode(TrieNode* node);
+  struct Node {
+    // Slice of `labels` holding the characters on the edge into this node.
+    uint32_t label_offset;
+    uint32_t label_len;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    bool is_end;
+  };
+  std::vector<Node> nodes;
+  std::string labels;
+  // Indexes of removed nodes, reused by later inserts.
+  std::vector<uint32_t> free_nodes;
+  // Bytes of `labels` no live node refers to any more.
+  size_t dead_bytes;
+  std::shared_mutex mutex;
+  std::string_view label(const Node& node) const;
+  uint32_t newNode(uint32_t label_offset, uint32_t label_len, bool is_end);
+  uint32_t findChild(uint32_t node, char c, uint32_t* prev = nullptr) const;
+  void linkChild(uint32_t parent, uint32_t child);
+  void insertLocked(std::string_view word);
+  // Rewrites `labels` with only the live labels, once enough of it is dead.
+  void compact();
+  // Finds the node reached by consuming `prefix`. `matched` is set to the
+  // number of characters of that node's label consumed (the prefix can end
+  // mid-label). Returns false if no word starts with `prefix`.
+  bool descend(std::string_view prefix, uint32_t* node,
+               uint32_t* matched) const;
 
  public:
   Trie();
-  ~Trie();
   void insert(const std::string& word);
+  // Inserts a batch of words under a single lock acquisition.
+  void insertAll(const std::vector<std::string>& words);
+  // Removes `word`, pruning nodes no other word needs. Returns whether it was
+  // present. The label pool is compacted once most of it is dead.
+  bool remove(const std::string& word);
   bool contains(const std::string& word);
+  // Number of characters stored, i.e., the node count of the equivalent
+  // uncompressed trie.
   int size();
-  std::vector<std::string> getWords(const std::string& prefix);
+  // Bytes held by the label pool, dead ones included.
+  size_t labelBytes();
+  // Words starting with `prefix` in lexicographic order, at most `limit` of
+  // them. An empty prefix matches nothing.
+  std::vector<std::string> getWords(
+      const std::string& prefix,
+      size_t limit = std::numeric_limits<size_t>::max());
+  // Calls `visit` with each word starting with `prefix` in lexicographic order,
+  // generating them lazily so the cost scales with the words visited rather
+  // than the size of the subtree. Stops after `limit` words or when `visit`
+  // returns false, and returns the number of words visited. The view is only
+  // valid during the call, and `visit` must not modify the trie.
+  size_t forEachWord(const std::string& prefix, size_t limit,
+                     const std::function<bool(std::string_view)>& visit);
+  // Longest string every word starting with `prefix` starts with, found by
+  // following single-child chains instead of enumerating. Returns `prefix`
+  // itself when nothing matches.
+  std::string longestCommonPrefix(const std::string& prefix);
 };
 extern Trie* GLOBAL_TRIE;
 
-char* AutoComplete(const char* text, int state);
+// Cap on the completions handed to readline for a single Tab.
+constexpr size_t kMaxCompletions = 256;
+
+// readline `rl_attempted_completion_function` completing command names from
+// `GLOBAL_TRIE`.
+char** AutoComplete(const char* text, int start, int end);
 
 #endif  // SRC_TRIE_H_
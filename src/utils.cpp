@@ -3,20 +3,28 @@
 
 #include "./utils.hpp"
 
-#include <spdlog/spdlog.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include <cstdio>
 #include <functional>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
-#include "./trie.hpp"
+#include "./io.hpp"
+#include "./lexer.hpp"
+#include "./path_cache.hpp"
+
+namespace slex = shell::lexer;
+namespace spc = shell::path_cache;
 
 #ifdef _WIN32
 constexpr char PATH_DELIMITER = ';';  // Windows uses a semicolon for path
@@ -25,269 +33,81 @@ constexpr char PATH_DELIMITER = ';';  // Windows uses a semicolon for path
 constexpr char PATH_DELIMITER = ':';  // Linux/macOS use a colon.
 #endif
 
-std::vector<std::string> SplitText(const std::string &input, char delimiter,
-                                   bool format) {
-  std::vector<std::string> res;
-  size_t prior_delimiter_ind = 0;
-  bool backslash = false;
-  spdlog::debug("Splitting text {} with delimiter {} and format {}.", input,
-                delimiter, format);
-  for (size_t i = 0; i < input.length(); i++) {
-    if (input[i] == '\\' && !backslash && format) {
-      backslash = true;
-    } else if (input[i] == '"' && !backslash && format) {
-      spdlog::debug("Found a \"");
-      size_t j = input.find('\"', i + 1);
-      if (j == std::string::npos) {
-        continue;
-      }
-      bool found = true;
-      while (input[j - 1] == '\\') {
-        j = input.find('\"', j + 1);
-        if (j == std::string::npos) {
-          found = false;
-          break;
-        }
-        found = true;
-      }
-      if (!found) continue;
-      spdlog::debug("Spitting at index {} and {}", i, j);
-      auto val = Trim(FormatText(input.substr(i, j - i + 1), false));
-      res.push_back(val);
-      prior_delimiter_ind = j + 1;
-      i = j;
-    } else if (input[i] == '\'' && !backslash && format) {
-      spdlog::debug("Found a '");
-      size_t j = input.find('\'', i + 1);
-      if (j == std::string::npos) {
-        continue;
-      }
-      bool found = true;
-      while (input[j - 1] == '\\') {
-        j = input.find('\'', j + 1);
-        if (j == std::string::npos) {
-          found = false;
-          break;
-        }
-        found = true;
-      }
-      if (!found) continue;
-      spdlog::debug("Spitting at index {} and {}", i, j);
-      auto val = Trim(FormatText(input.substr(i, j - i + 1), false));
-      res.push_back(val);
-      prior_delimiter_ind = j + 1;
-      i = j;
-    } else if (input[i] == delimiter && (!backslash || !format)) {
-      auto val =
-          Trim(input.substr(prior_delimiter_ind, i - prior_delimiter_ind));
-      if (!val.empty()) {
-        if (format) {
-          res.push_back(FormatText(val));
-        } else {
-          res.push_back(val);
-        }
-      }
-      prior_delimiter_ind = i + 1;
-    } else {
-      backslash = false;
-    }
-  }
-  // Handle last copy.
-  auto val = Trim(input.substr(prior_delimiter_ind));
-  spdlog::debug("Last arg  is {}", val);
-  if (!val.empty()) {
-    if (format) {
-      res.push_back(FormatText(val));
-    } else {
-      res.push_back(val);
-    }
-  }
-  spdlog::debug("Split text is: ");
-  for (auto x : res) {
-    spdlog::debug(" {}", x);
-  }
-  return res;
-}
-
-RedirectionInfo ParseRedirection(const std::string &input) {
-  std::ios_base::openmode open_mode;
-  RedirectType redirect_type = RedirectType::OUTPUT;
-  size_t operator_size = 0;
-  size_t operator_ind = std::string::npos;
-  for (size_t i = 0; i < input.length(); i++) {
-    if (input[i] == '>') {
-      operator_size += 1;
-      operator_ind = i;
-      if (i > 0 && (input[i - 1] == '1' || input[i - 1] == '2')) {
-        operator_ind = i - 1;
-        operator_size += 1;
-        redirect_type =
-            input[i - 1] == '1' ? RedirectType::OUTPUT : RedirectType::ERROR;
-      }
-      if (i < input.length() - 1) {
-        if (input[i + 1] == '>') {
-          operator_size += 1;
-          open_mode = std::ios_base::app;
-        } else {
-          open_mode = std::ios_base::out;
-        }
-      }
-      break;
+std::string EchoCommand(Args args) {
+  bool escapes = !args.empty() && args[0] == "-e";
+  std::string res;
+  for (size_t i = escapes ? 1 : 0; i < args.size(); i++) {
+    if (i > (escapes ? 1 : 0)) {
+      res += ' ';
     }
+    res.append(args[i]);
   }
-  if (operator_ind == std::string::npos) {
-    // open_mode doesn't matter in this case.
-    return RedirectionInfo{Trim(input), "", RedirectType::NONE,
-                           std::ios_base::out};
-  }
-  std::string command = Trim(input.substr(0, operator_ind));
-  std::string file =
-      FormatText(Trim(input.substr(operator_ind + operator_size)));
-
-  if (file.empty()) {
-    throw std::runtime_error("Must specify an output file.");
-  }
-  return RedirectionInfo{
-      command,
-      file,
-      redirect_type,
-      open_mode,
-  };
-}
-
-std::string Trim(std::string txt) {
-  return StripEndingWhitespace(StripBeginningWhitespace(txt));
-}
-
-std::string StripBeginningWhitespace(std::string txt) {
-  size_t first_non_whitespace_ind = txt.find_first_not_of(" ");
-  if (first_non_whitespace_ind == std::string::npos) {
-    return "";
-  }
-  return first_non_whitespace_ind == 0 ? txt
-                                       : txt.substr(first_non_whitespace_ind);
-}
-
-std::string StripEndingWhitespace(std::string txt) {
-  size_t last_non_whitespace_ind = txt.find_last_not_of(" ");
-  if (last_non_whitespace_ind == std::string::npos) {
-    return "";
-  }
-  return last_non_whitespace_ind == txt.length()
-             ? txt
-             : txt.substr(0, last_non_whitespace_ind + 1);
-}
-
-std::string EchoCommand(std::string arg) {
-  if (!arg.empty()) {
-    auto options = GetOptions(arg);
-    std::string clean_arg;
-    if (options.size() > 2) {
-      throw std::runtime_error("Only support -e command for echo");
-    }
-    if (options[0] == "-e") {
-      clean_arg = FormatText(options[1], true);
-    } else {
-      clean_arg = FormatText(options[0], false);
-    }
-    return clean_arg + '\n';
-  } else {
-    return "\n";
+  if (escapes) {
+    res = InterpretEscapes(res);
   }
+  return res + '\n';
 }
 
-std::vector<std::string> GetOptions(const std::string &input) {
-  static std::unordered_set<char> not_options = {' ', '-'};
-  std::vector<std::string> options;
-  bool opt = false;
-  size_t last_opt_ind = 0;
-  for (size_t i = 0; i < input.length(); i++) {
-    char c = input[i];
-    if (c == '-') {
-      opt = true;
-    } else if (opt && not_options.find(c) == not_options.end() &&
-               i < input.length() - 1 && input[i + 1] == ' ') {
-      options.push_back(input.substr(i - 1, 2));
-      opt = false;
-      last_opt_ind = i + 1;
-    }
-  }
-  if (last_opt_ind != input.length()) {
-    options.push_back(
-        Trim(input.substr(last_opt_ind, input.length() - last_opt_ind)));
+std::string EchoCommand(const std::string &arg) {
+  slex::Lexer lexer;
+  std::vector<std::string_view> args;
+  for (const auto &token : lexer.lex(arg)) {
+    args.push_back(token.text);
   }
-  return options;
+  return EchoCommand(args);
 }
 
-std::string FormatText(std::string txt, bool option_e) {
-  std::vector<char> txt_v = {};
-  static std::unordered_map<char, char> valid_e_escapes = {
-      {'"', '"'}, {'\\', '\\'}, {'$', '$'}, {'`', '`'}, {'n', '\n'},
+std::string InterpretEscapes(std::string_view txt) {
+  static const std::unordered_map<char, char> escapes = {
+      {'\\', '\\'}, {'n', '\n'}, {'t', '\t'},   {'r', '\r'},
+      {'a', '\a'},   {'b', '\b'}, {'v', '\v'},   {'f', '\f'},
+      {'e', '\033'},
   };
-  static std::unordered_map<char, char> valid_doubleq_escapes = {
-      {'"', '"'}, {'\\', '\\'}, {'$', '$'}, {'`', '`'}, {'\n', '\n'},
-  };
-  bool in_single_quote = false;
-  bool in_double_quote = false;
-  bool backslashed = false;
-  for (char c : txt) {
-    if (c == '\\' && !backslashed && !in_single_quote) {
-      backslashed = true;
-      continue;
-    }
-    if (c == '\'' && !in_double_quote && !backslashed) {
-      in_single_quote = !in_single_quote;
-    } else if (c == '"' && !in_single_quote && !backslashed) {
-      in_double_quote = !in_double_quote;
-    } else if (c == ' ' && txt_v.size() > 0 && txt_v.back() == ' ' &&
-               !in_single_quote && !in_double_quote && !backslashed) {
-      continue;
-    } else if (in_double_quote && backslashed) {
-      if (option_e) {
-        auto it = valid_e_escapes.find(c);
-        if (it != valid_e_escapes.end()) {
-          txt_v.push_back(it->second);
-        } else {
-          txt_v.push_back(c);
-        }
-      } else {
-        auto it = valid_doubleq_escapes.find(c);
-        if (it != valid_e_escapes.end()) {
-          txt_v.push_back(it->second);
-        } else {
-          txt_v.push_back('\\');
-          txt_v.push_back(c);
-        }
+  std::string res;
+  res.reserve(txt.size());
+  for (size_t i = 0; i < txt.size(); i++) {
+    if (txt[i] == '\\' && i + 1 < txt.size()) {
+      auto it = escapes.find(txt[i + 1]);
+      if (it != escapes.end()) {
+        res += it->second;
+        i++;
+        continue;
       }
-      backslashed = false;
-    } else {
-      backslashed = false;
-      txt_v.push_back(c);
     }
+    res += txt[i];
   }
-  auto res = std::string(txt_v.begin(), txt_v.end());
-  spdlog::debug("Formatted text was {} and is now {}.", txt, res);
   return res;
 }
 
-std::string TypeCommand(std::string command,
-                        std::unordered_set<std::string> valid_commands) {
-  if (valid_commands.find(command) != valid_commands.end()) {
-    return command + " is a shell builtin\n";
-  } else {
+int TypeCommand(Args args,
+                const std::unordered_set<std::string> &valid_commands,
+                shell::io::OutputSink *out) {
+  std::string missing;
+  for (auto arg : args) {
+    std::string command{arg};
+    if (valid_commands.find(command) != valid_commands.end()) {
+      out->write(command + " is a shell builtin\n");
+      continue;
+    }
     std::string path = GetCommandPath(command);
-    if (!path.empty()) {
-      return command + " is " + path + '\n';
+    if (path.empty()) {
+      if (!missing.empty()) missing += '\n';
+      missing += command + ": not found";
     } else {
-      throw std::runtime_error(command + ": not found");
+      out->write(command + " is " + path + '\n');
     }
   }
+  if (!missing.empty()) {
+    throw std::runtime_error(missing);
+  }
+  return 0;
 }
 
-std::string ChangeDirectoryCommand(std::string path) {
-  if (path[0] == '~') {
-    char *val = getenv("HOME");
-    std::string home_dir = val == NULL ? std::string("") : std::string(val);
+std::string ChangeDirectoryCommand(Args args) {
+  char *val = getenv("HOME");
+  std::string home_dir = val == NULL ? std::string("") : std::string(val);
+  std::string path = args.empty() ? home_dir : std::string(args[0]);
+  if (!path.empty() && path[0] == '~') {
     path = home_dir + path.substr(1);
   }
   fs::path dir = fs::path(path);
@@ -301,88 +121,63 @@ std::string ChangeDirectoryCommand(std::string path) {
   return "";
 }
 
-std::pair<std::string, std::string> GetCommandAndArgs(
-    const std::string &command) {
-  spdlog::debug("Getting command and args");
-  int first_non_whitespace_ind = command.find_first_not_of(" ");
-  std::string q = command.substr(first_non_whitespace_ind);
-  char delimiter = (q[0] == '\'') ? '\'' : (q[0] == '"') ? '"' : ' ';
-  spdlog::debug("Delimiter is {}", delimiter);
-  int end_ind = q.find_first_of(delimiter, 1);
-  if (end_ind == std::string::npos) {
-    return {q, ""};
+std::string GetCommandPath(const std::string &command) {
+  if (spc::GLOBAL_COMMAND_CACHE != nullptr) {
+    return spc::GLOBAL_COMMAND_CACHE->lookup(command);
   }
-  std::string quoted_command = q.substr(0, end_ind + 1);
-  std::string formatted_command = FormatText(quoted_command, false);
-  std::string args = q.substr(end_ind + 1);
-  return {Trim(formatted_command), Trim(args)};
+  for (const auto &loc : GetPathEntries()) {
+    std::string path = FindInPathEntry(loc, command);
+    if (!path.empty()) {
+      return path;
+    }
+  }
+  return "";
 }
 
-void FillTrieWithPathExecutables(Trie *trie) {
+std::vector<std::string> GetPathEntries() {
   char *val = getenv("PATH");
   std::string path = val == NULL ? std::string("") : std::string(val);
+  std::vector<std::string> entries;
   std::stringstream ss(path);
   std::string loc;
   while (std::getline(ss, loc, PATH_DELIMITER)) {
-    std::error_code loc_ec;
-    fs::path loc_path = fs::path(loc);
-    fs::file_status s = fs::status(loc_path, loc_ec);
-    if (loc_ec) {
-      continue;
-    } else if (fs::is_directory(s)) {
-      for (const auto &entry : fs::directory_iterator(loc)) {
-        std::string filename = entry.path().filename().string();
-        std::error_code file_ec;
-        fs::perms p = fs::status(entry, file_ec).permissions();
-        if (!file_ec && IsExecutable(p) && !trie->contains(filename)) {
-          trie->insert(filename);
-        }
-      }
-    } else if (fs::is_regular_file(s)) {
-      std::string filename = loc_path.filename().string();
-      fs::perms p = s.permissions();
-      if (IsExecutable(p) && !trie->contains(filename)) {
-        trie->insert(filename);
-      }
-    }
+    entries.push_back(loc);
   }
+  return entries;
 }
 
-std::string GetCommandPath(const std::string &command) {
-  char *val = getenv("PATH");
-  std::string path = val == NULL ? std::string("") : std::string(val);
-  std::stringstream ss(path);
-  std::string loc;
-  while (std::getline(ss, loc, PATH_DELIMITER)) {
-    std::error_code loc_ec;
-    fs::path loc_path = fs::path(loc);
-    fs::file_status s = fs::status(loc_path, loc_ec);
-    if (loc_ec) {
-      continue;
-    } else if (fs::is_directory(s)) {
-      for (const auto &entry : fs::directory_iterator(loc)) {
-        std::string filename = entry.path().filename().string();
-        if (command == filename) {
-          std::error_code file_ec;
-          fs::perms p = fs::status(entry, file_ec).permissions();
-          if (!file_ec && IsExecutable(p)) {
-            return entry.path().string();
-          }
-        }
-      }
-    } else if (fs::is_regular_file(s)) {
-      std::string filename = loc_path.filename().string();
-      if (command == filename) {
-        fs::perms p = s.permissions();
-        if (IsExecutable(p)) {
-          return loc;
-        }
-      }
+std::string FindInPathEntry(const std::string &loc,
+                            const std::string &command) {
+  if (command.empty() || command.find('/') != std::string::npos) {
+    return "";
+  }
+  struct stat s;
+  if (stat(loc.c_str(), &s) == -1) {
+    return "";
+  } else if (S_ISDIR(s.st_mode)) {
+    // A single lookup of dir/command instead of listing the directory.
+    std::string candidate = (fs::path(loc) / command).string();
+    if (IsExecutableFile(AT_FDCWD, candidate.c_str())) {
+      return candidate;
+    }
+  } else if (S_ISREG(s.st_mode)) {
+    std::string filename = fs::path(loc).filename().string();
+    if (command == filename && IsExecutableFile(AT_FDCWD, loc.c_str())) {
+      return loc;
     }
   }
   return "";
 }
 
+bool IsExecutableFile(int dir_fd, const char *path) {
+  if (faccessat(dir_fd, path, X_OK, 0) == -1) {
+    return false;
+  }
+  // faccessat is also happy with searchable directories.
+  struct stat s;
+  return fstatat(dir_fd, path, &s, 0) == 0 && S_ISREG(s.st_mode);
+}
+
 bool IsExecutable(fs::perms p) {
   return (p & fs::perms::owner_exec) != fs::perms::none ||
          (p & fs::perms::group_exec) != fs::perms::none ||
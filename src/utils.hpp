@@ -2,41 +2,38 @@
 #define SRC_UTILS_H_
 
 #include <filesystem>
+#include <span>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
-#include "./trie.hpp"
+#include "./io.hpp"
 
 namespace fs = std::filesystem;
-std::string EchoCommand(std::string arg);
-std::string TypeCommand(std::string command,
-                        std::unordered_set<std::string> valid_commands);
-std::string ChangeDirectoryCommand(std::string path);
-std::string FormatText(std::string txt, bool option_e = true);
+// Arguments handed to a builtin, not including its name.
+using Args = std::span<const std::string_view>;
+std::string EchoCommand(Args args);
+// Lexes `arg` first; for callers holding the raw argument string.
+std::string EchoCommand(const std::string& arg);
+// Writes what each of `args` resolves to. Names that resolve to nothing are
+// reported together once the others are written, by throwing.
+int TypeCommand(Args args,
+                const std::unordered_set<std::string>& valid_commands,
+                shell::io::OutputSink* out);
+std::string ChangeDirectoryCommand(Args args);
+// Resolves the backslash escapes `echo -e` understands.
+std::string InterpretEscapes(std::string_view txt);
+// Resolves `command` through PATH, going through `GLOBAL_COMMAND_CACHE` when
+// one is configured.
 std::string GetCommandPath(const std::string& command);
-std::pair<std::string, std::string> GetCommandAndArgs(
-    const std::string& command);
-std::string StripBeginningWhitespace(std::string txt);
-std::vector<std::string> SplitText(const std::string& input, char delimiter,
-                                   bool format = false);
-std::vector<std::string> GetOptions(const std::string& input);
-void FillTrieWithPathExecutables(Trie* trie);
-
-enum class RedirectType { NONE, OUTPUT, ERROR };
-// Holds information related to Redirection, e.g., what input is to be
-// redirected, what is the file to redirect to, what information is being
-// redirected (none, stdout or stderr), and what file open mode to use (write or
-// append).
-struct RedirectionInfo {
-  const std::string input;
-  const std::string file;
-  const RedirectType type;
-  const std::ios_base::openmode open_mode;
-};
-RedirectionInfo ParseRedirection(const std::string& input);
-std::string StripEndingWhitespace(std::string txt);
-std::string Trim(std::string txt);
+std::vector<std::string> GetPathEntries();
+// Returns the executable named `command` inside the PATH entry `loc`, or an
+// empty string if there isn't one.
+std::string FindInPathEntry(const std::string& loc, const std::string& command);
+// Whether `path`, relative to the directory open as `dir_fd` (or AT_FDCWD), is
+// a regular file the user may execute.
+bool IsExecutableFile(int dir_fd, const char* path);
 bool IsExecutable(fs::perms);
 
 #endif  // SRC_UTILS_H_
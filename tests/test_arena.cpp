@@ -0,0 +1,42 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "arena.hpp"
+
+namespace sarena = shell::arena;
+
+TEST_CASE("Arena", "[arena]") {
+  sarena::Arena arena{64};
+
+  SECTION("Copies survive later allocations") {
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 100; i++) {
+      views.push_back(arena.copy("word number " + std::to_string(i)));
+    }
+    for (int i = 0; i < 100; i++) {
+      REQUIRE(views[i] == "word number " + std::to_string(i));
+    }
+  }
+
+  SECTION("Alignment") {
+    arena.copy(std::string_view("x"));
+    std::vector<uint64_t> numbers = {1, 2, 3};
+    auto copied = arena.copy(std::span<const uint64_t>(numbers));
+    REQUIRE(reinterpret_cast<uintptr_t>(copied.data()) % alignof(uint64_t) ==
+            0);
+    REQUIRE(std::vector<uint64_t>(copied.begin(), copied.end()) == numbers);
+  }
+
+  SECTION("Oversized and reset") {
+    std::string big(1000, 'b');
+    REQUIRE(arena.copy(big) == big);
+    REQUIRE(arena.used() >= 1000);
+    arena.reset();
+    REQUIRE(arena.used() == 0);
+    REQUIRE(arena.copy(std::string_view("again")) == "again");
+  }
+}
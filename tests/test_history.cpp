@@ -1,9 +1,15 @@
+#include <fcntl.h>
 #include <spdlog/spdlog.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <catch2/catch.hpp>
 #include <cstdio>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "history.hpp"
@@ -85,4 +91,267 @@ TEST_CASE("HistoryTests", "[History]") {
     REQUIRE(hist3.get() == expected);
     remove("test_save_file.txt");
   }
+
+  SECTION("Indexed access") {
+    shist::History hist{3};
+    hist.insert("one");
+    hist.insert("two");
+    hist.insert("three");
+    hist.insert("four");
+    REQUIRE(hist[0] == "two");
+    REQUIRE(hist[1] == "three");
+    REQUIRE(hist[2] == "four");
+    std::vector<std::string> seen(hist.begin(), hist.end());
+    std::vector<std::string> expected = {"two", "three", "four"};
+    REQUIRE(seen == expected);
+  }
+
+  SECTION("Appending after eviction") {
+    shist::History hist{2};
+    hist.insert("one");
+    hist.save("test_append_file.txt", std::ios_base::out);
+    hist.insert("two");
+    hist.insert("three");
+    hist.insert("four");
+    // "two" was evicted before being appended, so it's lost, but nothing that
+    // is still in memory may be skipped.
+    hist.save("test_append_file.txt", std::ios_base::app);
+    shist::History loaded{10};
+    loaded.load("test_append_file.txt");
+    std::vector<std::string> expected = {"one", "three", "four"};
+    REQUIRE(loaded.getReverse() == expected);
+    hist.save("test_append_file.txt", std::ios_base::app);
+    shist::History reloaded{10};
+    reloaded.load("test_append_file.txt");
+    REQUIRE(reloaded.getReverse() == expected);
+    remove("test_append_file.txt");
+  }
+
+  SECTION("Many inserts") {
+    shist::History hist{50};
+    for (int i = 0; i < 10000; i++) {
+      hist.insert("command number " + std::to_string(i));
+    }
+    REQUIRE(hist.size == 50);
+    for (size_t i = 0; i < hist.size; i++) {
+      REQUIRE(hist[i] == "command number " + std::to_string(9950 + i));
+    }
+  }
+
+  SECTION("Editing entries") {
+    shist::History hist{2};
+    hist.insert("one");
+    hist.insert("two");
+    hist.setCurrentTxt("draft");
+    hist.incrementCurrent();
+    REQUIRE(hist.getCurrentTxt() == "two");
+    hist.setCurrentTxt("two edited");
+    hist.incrementCurrent();
+    REQUIRE(hist.getCurrentTxt() == "one");
+    hist.decrementCurrent();
+    REQUIRE(hist.getCurrentTxt() == "two edited");
+    hist.decrementCurrent();
+    REQUIRE(hist.getCurrentTxt() == "draft");
+    REQUIRE(hist[1] == "two edited");
+  }
+
+  SECTION("Loading keeps the newest lines") {
+    {
+      std::ofstream file{"test_load_file.txt"};
+      for (int i = 0; i < 1000; i++) {
+        file << "cmd " << i << "\n\n";
+      }
+      file << "last without newline";
+    }
+    shist::History hist{3};
+    hist.insert("already here");
+    hist.load("test_load_file.txt");
+    std::vector<std::string> expected = {"cmd 998", "cmd 999",
+                                         "last without newline"};
+    REQUIRE(hist.getReverse() == expected);
+    shist::History empty{3};
+    empty.load("test_missing_file.txt");
+    REQUIRE(empty.size == 0);
+    remove("test_load_file.txt");
+  }
+
+  SECTION("Persisting to the attached file") {
+    remove("test_attach_file.txt");
+    {
+      shist::History hist{5};
+      hist.attach("test_attach_file.txt");
+      hist.insert("one");
+      hist.persist();
+      hist.insert("two");
+      hist.insert("three");
+      hist.persist();
+      hist.persist();
+      // Already persisted, so nothing is appended twice.
+      hist.save("test_attach_file.txt", std::ios_base::app);
+    }
+    shist::History hist{5};
+    hist.attach("test_attach_file.txt");
+    std::vector<std::string> expected = {"one", "two", "three"};
+    REQUIRE(hist.getReverse() == expected);
+    hist.insert("four");
+    hist.save("test_attach_file.txt", std::ios_base::out);
+    hist.persist();
+    shist::History reloaded{5};
+    reloaded.load("test_attach_file.txt");
+    expected = {"one", "two", "three", "four"};
+    REQUIRE(reloaded.getReverse() == expected);
+    remove("test_attach_file.txt");
+  }
+
+  SECTION("Merging other sessions") {
+    remove("test_merge_file.txt");
+    shist::History first{10};
+    shist::History second{10};
+    first.attach("test_merge_file.txt");
+    second.attach("test_merge_file.txt");
+    first.insert("from first");
+    first.persist();
+    second.insert("from second");
+    second.persist();
+    first.insert("first again");
+    first.persist();
+    REQUIRE(second.merge() == 2);
+    std::vector<std::string> expected = {"from second", "from first",
+                                         "first again"};
+    REQUIRE(second.getReverse() == expected);
+    REQUIRE(second.merge() == 0);
+    REQUIRE(first.merge() == 1);
+    expected = {"from first", "first again", "from second"};
+    REQUIRE(first.getReverse() == expected);
+    // Merged entries belong to the file already.
+    second.persist();
+    shist::History reloaded{10};
+    reloaded.load("test_merge_file.txt");
+    expected = {"from first", "from second", "first again"};
+    REQUIRE(reloaded.getReverse() == expected);
+    remove("test_merge_file.txt");
+  }
+
+  SECTION("Timestamped records") {
+    remove("test_stamp_file.txt");
+    {
+      shist::History hist{10};
+      hist.timestamps = true;
+      hist.attach("test_stamp_file.txt");
+      hist.insert("stamped");
+      hist.persist();
+    }
+    std::ifstream file{"test_stamp_file.txt"};
+    std::string header, line;
+    std::getline(file, header);
+    std::getline(file, line);
+    REQUIRE(header.rfind("#", 0) == 0);
+    REQUIRE(header.find(':') != std::string::npos);
+    REQUIRE(line == "stamped");
+    shist::History hist{10};
+    hist.load("test_stamp_file.txt");
+    REQUIRE(hist.size == 1);
+    REQUIRE(hist[0] == "stamped");
+    REQUIRE(hist.timestamp(0) != 0);
+    remove("test_stamp_file.txt");
+  }
+
+  SECTION("Concurrent sessions don't interleave") {
+    remove("test_concurrent_file.txt");
+    constexpr int kSessions = 4;
+    constexpr int kCommands = 200;
+    std::string padding(3000, 'x');
+    std::vector<pid_t> pids;
+    for (int s = 0; s < kSessions; s++) {
+      pid_t pid = fork();
+      if (pid == 0) {
+        shist::History hist{kCommands};
+        hist.attach("test_concurrent_file.txt");
+        for (int i = 0; i < kCommands; i++) {
+          hist.insert("echo " + std::to_string(s) + " " + padding);
+          hist.persist();
+        }
+        _exit(0);
+      }
+      pids.push_back(pid);
+    }
+    for (pid_t pid : pids) {
+      waitpid(pid, nullptr, 0);
+    }
+    shist::History hist{kSessions * kCommands * 2};
+    hist.load("test_concurrent_file.txt");
+    REQUIRE(hist.size == kSessions * kCommands);
+    for (auto entry : hist) {
+      REQUIRE(entry.size() == padding.size() + 7);
+    }
+    remove("test_concurrent_file.txt");
+  }
+
+  SECTION("Search") {
+    shist::History hist{200};
+    std::vector<std::string> words = {"git", "ls", "make", "cd", "echo",
+                                      "grep", "cat", "rm", "tar"};
+    std::vector<std::string> all;
+    uint32_t state = 42;
+    for (int i = 0; i < 1000; i++) {
+      std::string entry;
+      for (int w = 0; w < 3; w++) {
+        state = state * 1103515245 + 12345;
+        entry += words[(state >> 16) % words.size()] + " ";
+      }
+      entry += std::to_string(i % 37);
+      hist.insert(entry);
+      all.push_back(entry);
+    }
+    std::vector<std::string> queries = {"g",        "ls",    "make cd", "t",
+                                        "echo 3",   "rm rm", "cat ca",  "36",
+                                        "git git ", "zzz",   "tar 1"};
+    for (const auto& query : queries) {
+      // Walk every match newest to oldest like repeated C-r presses.
+      size_t before = hist.size;
+      size_t expected = all.size();
+      while (true) {
+        size_t found = hist.search(query, before);
+        do {
+          expected--;
+        } while (expected >= all.size() - hist.size &&
+                 all[expected].find(query) == std::string::npos);
+        if (expected < all.size() - hist.size) {
+          REQUIRE(found == hist.size);
+          break;
+        }
+        REQUIRE(found == expected - (all.size() - hist.size));
+        before = found;
+      }
+    }
+    REQUIRE(hist.search("", hist.size) == hist.size);
+  }
+
+  SECTION("The history builtin streams the last N entries") {
+    shist::History hist{};
+    std::string long_entry(300, 'x');
+    hist.insert("ls");
+    hist.insert(long_entry);
+    hist.insert("pwd");
+    shist::GLOBAL_HISTORY = &hist;
+    unsetenv("HISTTIMEFORMAT");
+    auto run = [](std::vector<std::string_view> args) {
+      int fd = open("test_history_builtin.txt",
+                    O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      {
+        shell::io::OutputSink out{fd};
+        shist::HistoryCommand(args, &out);
+      }
+      close(fd);
+      std::ifstream file{"test_history_builtin.txt"};
+      return std::string(std::istreambuf_iterator<char>(file), {});
+    };
+    REQUIRE(run({}) == "    1  ls\n    2  " + long_entry + "\n    3  pwd\n");
+    REQUIRE(run({"2"}) == "    2  " + long_entry + "\n    3  pwd\n");
+    REQUIRE(run({"10"}) == run({}));
+    REQUIRE(run({"0"}).empty());
+    REQUIRE_THROWS(run({"-w"}));
+    shist::GLOBAL_HISTORY = nullptr;
+    remove("test_history_builtin.txt");
+  }
 }
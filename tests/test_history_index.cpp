@@ -0,0 +1,60 @@
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "history_index.hpp"
+
+namespace shist = shell::history;
+
+TEST_CASE("TrigramIndexTests", "[TrigramIndex]") {
+  shist::TrigramIndex index{};
+  index.add(0, "git status");
+  index.add(1, "git commit");
+  index.add(2, "ls");
+  index.add(3, "aaaaa");
+
+  SECTION("Candidates") {
+    auto* list = index.candidates("git");
+    REQUIRE(list != nullptr);
+    REQUIRE(*list == std::vector<uint64_t>{0, 1});
+    list = index.candidates("commit");
+    REQUIRE(list != nullptr);
+    REQUIRE(*list == std::vector<uint64_t>{1});
+    REQUIRE(index.candidates("svn") == nullptr);
+    // "git" and "t c" both occur, but "it c" only occurs in entry 1.
+    list = index.candidates("it c");
+    REQUIRE(list != nullptr);
+    REQUIRE(*list == std::vector<uint64_t>{1});
+  }
+
+  SECTION("Repeated trigrams are listed once") {
+    auto* list = index.candidates("aaa");
+    REQUIRE(list != nullptr);
+    REQUIRE(*list == std::vector<uint64_t>{3});
+  }
+
+  SECTION("Prune") {
+    size_t before = index.size();
+    index.prune(1);
+    REQUIRE(index.size() < before);
+    REQUIRE(index.candidates("status") == nullptr);
+    auto* list = index.candidates("git");
+    REQUIRE(list != nullptr);
+    REQUIRE(*list == std::vector<uint64_t>{1});
+    index.prune(4);
+    REQUIRE(index.size() == 0);
+  }
+
+  SECTION("Sequence numbers past 32 bits") {
+    shist::TrigramIndex late{};
+    uint64_t base = uint64_t{1} << 32;
+    late.add(base - 1, "git log");
+    late.add(base, "git log");
+    late.add(base + 1, "make");
+    auto* list = late.candidates("git");
+    REQUIRE(list != nullptr);
+    REQUIRE(*list == std::vector<uint64_t>{base - 1, base});
+    late.prune(base);
+    REQUIRE(*late.candidates("git") == std::vector<uint64_t>{base});
+  }
+}
@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "io.hpp"
+
+namespace sio = shell::io;
+
+namespace {
+std::string ReadFile(const std::string& filename) {
+  std::ifstream read_file{filename};
+  std::stringstream ss;
+  ss << read_file.rdbuf();
+  return ss.str();
+}
+}  // namespace
+
+TEST_CASE("LineReader", "[io]") {
+  SECTION("Reads the lines of a mapped file") {
+    {
+      std::ofstream file{"test_line_reader.txt"};
+      file << "first\n\nthird\nno newline";
+    }
+    int fd = open("test_line_reader.txt", O_RDONLY);
+    sio::LineReader reader{fd};
+    std::vector<std::string> lines;
+    std::string_view line;
+    while (reader.next(&line)) lines.emplace_back(line);
+    close(fd);
+    REQUIRE(lines ==
+            std::vector<std::string>{"first", "", "third", "no newline"});
+    remove("test_line_reader.txt");
+  }
+
+  SECTION("Reads lines longer than its buffer from a pipe") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    std::string long_line(200000, 'x');
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      sio::WriteAll(fds[1], "short\n" + long_line + "\nlast\n");
+      _exit(0);
+    }
+    close(fds[1]);
+    sio::LineReader reader{fds[0]};
+    std::vector<std::string> lines;
+    std::string_view line;
+    while (reader.next(&line)) lines.emplace_back(line);
+    close(fds[0]);
+    waitpid(pid, NULL, 0);
+    REQUIRE(lines == std::vector<std::string>{"short", long_line, "last"});
+  }
+
+  SECTION("Leaves the rest of a shared pipe unread") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    sio::WriteAll(fds[1], "cat\nhello\nlast");
+    close(fds[1]);
+    sio::LineReader reader{fds[0], true};
+    std::string_view line;
+    REQUIRE(reader.next(&line));
+    REQUIRE(line == "cat");
+    char rest[16];
+    REQUIRE(read(fds[0], rest, 6) == 6);
+    REQUIRE(std::string(rest, 6) == "hello\n");
+    REQUIRE(reader.next(&line));
+    REQUIRE(line == "last");
+    REQUIRE_FALSE(reader.next(&line));
+    close(fds[0]);
+  }
+
+  SECTION("Follows the offset of a shared file") {
+    {
+      std::ofstream file{"test_line_reader.txt"};
+      file << "cat\nhello\nlast\n";
+    }
+    int fd = open("test_line_reader.txt", O_RDONLY);
+    sio::LineReader reader{fd, true};
+    std::string_view line;
+    REQUIRE(reader.next(&line));
+    REQUIRE(line == "cat");
+    REQUIRE(lseek(fd, 0, SEEK_CUR) == 4);
+    // A command consumes the next line itself.
+    char rest[16];
+    REQUIRE(read(fd, rest, 6) == 6);
+    REQUIRE(reader.next(&line));
+    REQUIRE(line == "last");
+    REQUIRE_FALSE(reader.next(&line));
+    close(fd);
+    remove("test_line_reader.txt");
+  }
+}
+
+TEST_CASE("OutputSink", "[io]") {
+  SECTION("Batches copied and referenced pieces in order") {
+    int fd = open("test_output_sink.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    std::string expected;
+    std::vector<std::string> refs;
+    {
+      sio::OutputSink out{fd};
+      for (int i = 0; i < 5000; i++) {
+        std::string small = std::to_string(i) + ": ";
+        refs.push_back(std::string(100 + i % 300, 'a' + i % 26));
+        out.write(small);
+        out.writeRef(refs.back());
+        out.write("\n");
+        expected += small + refs.back() + "\n";
+      }
+      // More than a whole buffer in one piece.
+      std::string huge(3 * sio::kBufferSize + 7, 'z');
+      out.write(huge);
+      expected += huge;
+      out.flush();
+      REQUIRE(out.written() == expected.size());
+      out.write("tail");
+      expected += "tail";
+    }
+    close(fd);
+    REQUIRE(ReadFile("test_output_sink.txt") == expected);
+    remove("test_output_sink.txt");
+  }
+
+  SECTION("Reports a closed reader as EPIPE") {
+    int fds[2];
+    REQUIRE(pipe(fds) == 0);
+    close(fds[0]);
+    signal(SIGPIPE, SIG_IGN);
+    sio::OutputSink out{fds[1]};
+    out.write("lost");
+    try {
+      out.flush();
+      FAIL("flush should have thrown");
+    } catch (const std::system_error& e) {
+      REQUIRE(e.code() == std::errc::broken_pipe);
+    }
+    signal(SIGPIPE, SIG_DFL);
+    close(fds[1]);
+  }
+}
@@ -0,0 +1,143 @@
+#include <signal.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "io.hpp"
+#include "jobs.hpp"
+#include "launcher.hpp"
+#include "parser.hpp"
+#include "timing.hpp"
+
+namespace sio = shell::io;
+namespace sjobs = shell::jobs;
+namespace launch = shell::launcher;
+namespace sparse = shell::parser;
+namespace stiming = shell::timing;
+
+namespace {
+// Spawns `sh -c script` as the next process of `job`.
+void Start(sjobs::JobTable* table, sjobs::Job* job, const std::string& script,
+           size_t stage = 0) {
+  launch::FileActions actions;
+  launch::Attributes attributes;
+  table->prepare(*job, &actions, &attributes);
+  pid_t pid =
+      launch::Spawn("/bin/sh", {"sh", "-c", script}, actions, &attributes);
+  table->addProcess(job, pid, stage);
+}
+
+// What `print` writes for `job`.
+std::string Line(const sjobs::JobTable& table, const sjobs::Job& job) {
+  int pipefd[2];
+  REQUIRE(pipe(pipefd) == 0);
+  {
+    sio::OutputSink out{pipefd[1]};
+    table.print(job, false, &out);
+  }
+  close(pipefd[1]);
+  std::string res(256, '\0');
+  res.resize(std::max<ssize_t>(read(pipefd[0], res.data(), res.size()), 0));
+  close(pipefd[0]);
+  return res;
+}
+}  // namespace
+
+TEST_CASE("Describe", "[jobs]") {
+  sparse::Parser parser;
+  const auto& pipeline =
+      parser.parse("sort -r  <in | head 2>&1 >> out").pipelines[0];
+  REQUIRE(sjobs::Describe(pipeline) == "sort -r <in | head 2>&1 >>out");
+}
+
+TEST_CASE("JobTable", "[jobs]") {
+  sjobs::JobTable table{false};
+  REQUIRE_FALSE(table.jobControl());
+  REQUIRE(table.owner());
+
+  SECTION("Waits for a foreground job and reports statuses by stage") {
+    sjobs::Job* job = table.create("a | b", true);
+    Start(&table, job, "exit 2", 0);
+    Start(&table, job, "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done;"
+                       " exit 3", 1);
+    std::vector<int> statuses(2, -1);
+    REQUIRE(table.foreground(job, false, &statuses) == 3);
+    REQUIRE(statuses == std::vector<int>{2, 3});
+    REQUIRE(table.all().empty());
+  }
+
+  SECTION("Records the usage of finished processes") {
+    sjobs::Job* job = table.create("busy", false);
+    Start(&table, job, "i=0; while [ $i -lt 50000 ]; do i=$((i+1)); done");
+    while (job->state() != sjobs::State::DONE) {
+      usleep(1000);
+      table.reap();
+    }
+    REQUIRE(job->status() == 0);
+    const auto& usage = job->processes[0].usage;
+    REQUIRE((usage.user + usage.sys).count() > 0);
+    REQUIRE(usage.max_rss > 0);
+    // Only measured for timed jobs.
+    REQUIRE(usage.real.count() == 0);
+    table.remove(job);
+  }
+
+  SECTION("Measures timed jobs by stage") {
+    sjobs::Job* job = table.create("a | b", true);
+    job->timed = true;
+    job->started = std::chrono::steady_clock::now();
+    Start(&table, job, "printf 12345 >/dev/null", 0);
+    Start(&table, job, "sleep 0.05; printf 123 >/dev/null", 1);
+    std::vector<stiming::Usage> usages(2);
+    REQUIRE(table.foreground(job, false, nullptr, &usages) == 0);
+    REQUIRE(usages[0].written == 5);
+    REQUIRE(usages[1].written == 3);
+    REQUIRE(usages[1].real >= std::chrono::milliseconds(50));
+    REQUIRE(usages[0].real <= usages[1].real);
+  }
+
+  SECTION("Lists background jobs and reaps them without blocking") {
+    sjobs::Job* job = table.create("sleep 10", false);
+    Start(&table, job, "exec sleep 10");
+    table.reap();
+    REQUIRE(job->state() == sjobs::State::RUNNING);
+    REQUIRE(Line(table, *job) == "[1]+  Running                 sleep 10 &\n");
+
+    pid_t pid = job->processes[0].pid;
+    kill(pid, SIGSTOP);
+    REQUIRE(table.wait(job) == 128 + SIGSTOP);
+    REQUIRE(job->state() == sjobs::State::STOPPED);
+    REQUIRE(Line(table, *job) == "[1]+  Stopped                 sleep 10\n");
+
+    kill(pid, SIGCONT);
+    while (job->state() != sjobs::State::RUNNING) {
+      table.reap();
+    }
+    kill(pid, SIGTERM);
+    REQUIRE(table.wait(job) == 128 + SIGTERM);
+    REQUIRE(table.all().empty());
+  }
+
+  SECTION("Finds jobs by spec") {
+    sjobs::Job* first = table.create("sleep 1", false);
+    Start(&table, first, "exec sleep 1");
+    sjobs::Job* second = table.create("cat", false);
+    Start(&table, second, "exec sleep 1");
+    REQUIRE(table.find("") == second);
+    REQUIRE(table.find("%%") == second);
+    REQUIRE(table.find("%+") == second);
+    REQUIRE(table.find("%-") == first);
+    REQUIRE(table.find("%1") == first);
+    REQUIRE(table.find("%sl") == first);
+    REQUIRE(table.find(std::to_string(second->processes[0].pid)) == second);
+    REQUIRE(table.find("%3") == nullptr);
+    REQUIRE(table.find("%dog") == nullptr);
+    kill(first->processes[0].pid, SIGKILL);
+    kill(second->processes[0].pid, SIGKILL);
+    REQUIRE(table.wait(first) == 128 + SIGKILL);
+    REQUIRE(table.wait(second) == 128 + SIGKILL);
+  }
+}
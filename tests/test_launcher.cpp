@@ -0,0 +1,66 @@
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "launcher.hpp"
+
+namespace launch = shell::launcher;
+
+namespace {
+std::string ReadAll(int fd) {
+  std::string res;
+  char buffer[256];
+  ssize_t bytes;
+  while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
+    res.append(buffer, bytes);
+  }
+  return res;
+}
+}  // namespace
+
+TEST_CASE("Spawn", "[launcher]") {
+  SECTION("Wires stdin and stdout") {
+    int in_pipe[2];
+    int out_pipe[2];
+    REQUIRE(pipe2(in_pipe, O_CLOEXEC) == 0);
+    REQUIRE(pipe2(out_pipe, O_CLOEXEC) == 0);
+    launch::FileActions actions;
+    actions.dup2(in_pipe[0], STDIN_FILENO);
+    actions.dup2(out_pipe[1], STDOUT_FILENO);
+    pid_t pid = launch::Spawn("/bin/cat", {"cat"}, actions);
+    REQUIRE(pid > 0);
+    close(in_pipe[0]);
+    close(out_pipe[1]);
+    REQUIRE(write(in_pipe[1], "hello there\n", 12) == 12);
+    close(in_pipe[1]);
+    REQUIRE(ReadAll(out_pipe[0]) == "hello there\n");
+    close(out_pipe[0]);
+    int status;
+    REQUIRE(waitpid(pid, &status, 0) == pid);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+  }
+
+  SECTION("Passes arguments") {
+    int out_pipe[2];
+    REQUIRE(pipe2(out_pipe, O_CLOEXEC) == 0);
+    launch::FileActions actions;
+    actions.dup2(out_pipe[1], STDOUT_FILENO);
+    pid_t pid = launch::Spawn("/bin/echo", {"echo", "hi", "there"}, actions);
+    close(out_pipe[1]);
+    REQUIRE(ReadAll(out_pipe[0]) == "hi there\n");
+    close(out_pipe[0]);
+    waitpid(pid, NULL, 0);
+  }
+
+  SECTION("Missing program") {
+    launch::FileActions actions;
+    REQUIRE_THROWS_AS(launch::Spawn("/does/not/exist", {"exist"}, actions),
+                      std::runtime_error);
+  }
+}
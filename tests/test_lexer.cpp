@@ -0,0 +1,103 @@
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexer.hpp"
+
+namespace slex = shell::lexer;
+
+namespace {
+std::vector<std::string> Words(slex::Lexer* lexer, std::string_view input) {
+  std::vector<std::string> words;
+  for (const auto& token : lexer->lex(input)) {
+    words.emplace_back(token.text);
+  }
+  return words;
+}
+}  // namespace
+
+TEST_CASE("Lexer", "[lexer]") {
+  slex::Lexer lexer{};
+
+  SECTION("Plain words point into the input") {
+    std::string input = "  cat   /tmp/bee/f1 ";
+    const auto& tokens = lexer.lex(input);
+    REQUIRE(tokens.size() == 2);
+    REQUIRE(tokens[0].type == slex::TokenType::WORD);
+    REQUIRE(tokens[0].text == "cat");
+    REQUIRE(tokens[0].text.data() == input.data() + 2);
+    REQUIRE(tokens[1].text == "/tmp/bee/f1");
+  }
+
+  SECTION("Quotes and escapes") {
+    std::vector<std::string> expected = {"exe  with  space", "/tmp/bee/f1"};
+    REQUIRE(Words(&lexer, "'exe  with  space' /tmp/bee/f1") == expected);
+    expected = {"exe with \\'single quotes\\'", "/tmp/ant/f3"};
+    REQUIRE(Words(&lexer, "\"exe with \\'single quotes\\'\" /tmp/ant/f3") ==
+            expected);
+    expected = {"cat", "/tmp/pig/\"f 43\""};
+    REQUIRE(Words(&lexer, "cat \"/tmp/pig/\\\"f 43\\\"\"") == expected);
+    expected = {"hello      script"};
+    REQUIRE(Words(&lexer, "hello\\ \\ \\ \\ \\ \\ script") == expected);
+    expected = {"before\\   after", "ab"};
+    REQUIRE(Words(&lexer, "\"before\\   after\" a\"\"b") == expected);
+    expected = {"", "x"};
+    REQUIRE(Words(&lexer, "'' x") == expected);
+  }
+
+  SECTION("Unterminated quotes") {
+    REQUIRE_THROWS_AS(lexer.lex("echo 'hi"), std::runtime_error);
+    REQUIRE_THROWS_AS(lexer.lex("echo \"hi"), std::runtime_error);
+  }
+
+  SECTION("Operators") {
+    const auto& tokens = lexer.lex("cat f|wc -l 2>>err.txt >out <in &>all");
+    std::vector<slex::TokenType> types;
+    for (const auto& token : tokens) {
+      types.push_back(token.type);
+    }
+    using T = slex::TokenType;
+    std::vector<slex::TokenType> expected = {
+        T::WORD,     T::WORD, T::PIPE,     T::WORD, T::WORD,     T::REDIRECT,
+        T::WORD,     T::REDIRECT, T::WORD, T::REDIRECT, T::WORD, T::REDIRECT,
+        T::WORD};
+    REQUIRE(types == expected);
+    REQUIRE(tokens[5].op == slex::RedirectOp::APPEND);
+    REQUIRE(tokens[5].fd == 2);
+    REQUIRE(tokens[6].text == "err.txt");
+    REQUIRE(tokens[7].op == slex::RedirectOp::OUTPUT);
+    REQUIRE(tokens[7].fd == -1);
+    REQUIRE(tokens[9].op == slex::RedirectOp::INPUT);
+    REQUIRE(tokens[11].op == slex::RedirectOp::ALL);
+  }
+
+  SECTION("Numbers are only fds when glued to the operator") {
+    const auto& tokens = lexer.lex("echo 2 >f 2>&1 '2'>g");
+    REQUIRE(tokens[1].type == slex::TokenType::WORD);
+    REQUIRE(tokens[1].text == "2");
+    REQUIRE(tokens[2].fd == -1);
+    REQUIRE(tokens[4].op == slex::RedirectOp::DUP_OUTPUT);
+    REQUIRE(tokens[4].fd == 2);
+    REQUIRE(tokens[5].text == "1");
+    REQUIRE(tokens[6].type == slex::TokenType::WORD);
+    REQUIRE(tokens[6].text == "2");
+    REQUIRE(tokens[7].fd == -1);
+  }
+
+  SECTION("Lists and comments") {
+    const auto& tokens = lexer.lex("a && b || c; d & # e f");
+    std::vector<slex::TokenType> types;
+    for (const auto& token : tokens) {
+      types.push_back(token.type);
+    }
+    using T = slex::TokenType;
+    std::vector<slex::TokenType> expected = {
+        T::WORD, T::AND,       T::WORD, T::OR,
+        T::WORD, T::SEMICOLON, T::WORD, T::AMPERSAND};
+    REQUIRE(types == expected);
+    std::vector<std::string> words = {"a#b"};
+    REQUIRE(Words(&lexer, "a#b") == words);
+  }
+}
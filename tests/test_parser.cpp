@@ -0,0 +1,108 @@
+#include <catch2/catch.hpp>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "lexer.hpp"
+#include "parser.hpp"
+
+namespace slex = shell::lexer;
+namespace sparse = shell::parser;
+
+namespace {
+std::vector<std::string> Argv(const sparse::Command& command) {
+  return std::vector<std::string>(command.argv.begin(), command.argv.end());
+}
+}  // namespace
+
+TEST_CASE("Parser", "[parser]") {
+  sparse::Parser parser{};
+
+  SECTION("Simple command") {
+    const auto& program = parser.parse("  echo 'hello   world'  there ");
+    REQUIRE(program.pipelines.size() == 1);
+    REQUIRE(program.pipelines[0].commands.size() == 1);
+    const auto& command = program.pipelines[0].commands[0];
+    std::vector<std::string> expected = {"echo", "hello   world", "there"};
+    REQUIRE(Argv(command) == expected);
+    REQUIRE(command.redirects.empty());
+  }
+
+  SECTION("Pipelines, lists and redirections") {
+    const auto& program =
+        parser.parse("cat f | grep 'a|b' 2>>err && echo ok || echo no; ls &");
+    REQUIRE(program.pipelines.size() == 4);
+    const auto& first = program.pipelines[0];
+    REQUIRE(first.connector == sparse::Connector::AND);
+    REQUIRE(first.commands.size() == 2);
+    std::vector<std::string> expected = {"grep", "a|b"};
+    REQUIRE(Argv(first.commands[1]) == expected);
+    REQUIRE(first.commands[1].redirects.size() == 1);
+    const auto& redirect = first.commands[1].redirects[0];
+    REQUIRE(redirect.op == slex::RedirectOp::APPEND);
+    REQUIRE(redirect.fd == 2);
+    REQUIRE(redirect.target == "err");
+    REQUIRE(program.pipelines[1].connector == sparse::Connector::OR);
+    REQUIRE(program.pipelines[2].connector == sparse::Connector::SEQUENCE);
+    REQUIRE(program.pipelines[3].connector == sparse::Connector::BACKGROUND);
+  }
+
+  SECTION("The time keyword") {
+    const auto& program = parser.parse("time yes | head; time; echo time");
+    REQUIRE(program.pipelines.size() == 3);
+    REQUIRE(program.pipelines[0].timed);
+    REQUIRE(program.pipelines[0].commands.size() == 2);
+    REQUIRE(Argv(program.pipelines[0].commands[0]) ==
+            std::vector<std::string>{"yes"});
+    // Without a command to time, it's just a word.
+    REQUIRE_FALSE(program.pipelines[1].timed);
+    REQUIRE(Argv(program.pipelines[1].commands[0]) ==
+            std::vector<std::string>{"time"});
+    REQUIRE_FALSE(program.pipelines[2].timed);
+  }
+
+  SECTION("Redirections anywhere in the command") {
+    const auto& program = parser.parse(">out echo a 2>err b");
+    const auto& command = program.pipelines[0].commands[0];
+    std::vector<std::string> expected = {"echo", "a", "b"};
+    REQUIRE(Argv(command) == expected);
+    REQUIRE(command.redirects.size() == 2);
+    REQUIRE(command.redirects[0].target == "out");
+    REQUIRE(command.redirects[1].target == "err");
+  }
+
+  SECTION("Empty line") {
+    REQUIRE(parser.parse("   ").pipelines.empty());
+  }
+
+  SECTION("Syntax errors") {
+    REQUIRE_THROWS_AS(parser.parse("| echo"), std::runtime_error);
+    REQUIRE_THROWS_AS(parser.parse("echo |"), std::runtime_error);
+    REQUIRE_THROWS_AS(parser.parse("echo &&"), std::runtime_error);
+    REQUIRE_THROWS_AS(parser.parse("echo >"), std::runtime_error);
+    REQUIRE_THROWS_AS(parser.parse("echo > | cat"), std::runtime_error);
+    REQUIRE_THROWS_AS(parser.parse("; echo"), std::runtime_error);
+    REQUIRE_NOTHROW(parser.parse("echo ;"));
+  }
+
+  SECTION("Cache") {
+    std::string line = "echo cached | cat";
+    const auto* first = &parser.parse(line);
+    REQUIRE(parser.hits() == 0);
+    // Independent of the caller's buffer.
+    line[5] = 'X';
+    line = "echo cached | cat";
+    const auto* second = &parser.parse(line);
+    REQUIRE(parser.hits() == 1);
+    REQUIRE(first == second);
+    REQUIRE(second->pipelines[0].commands[0].argv[1] == "cached");
+    for (size_t i = 0; i < sparse::kParseCacheSize; i++) {
+      parser.parse("echo " + std::to_string(i));
+    }
+    parser.parse(line);
+    REQUIRE(parser.hits() == 1);
+    REQUIRE(parser.parse(line).pipelines[0].commands.size() == 2);
+    REQUIRE(parser.hits() == 2);
+  }
+}
@@ -0,0 +1,110 @@
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <catch2/catch.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "path_cache.hpp"
+
+namespace fs = std::filesystem;
+namespace spc = shell::path_cache;
+
+namespace {
+void MakeExecutable(const fs::path& path) {
+  std::ofstream{path} << "#!/bin/sh\n";
+  fs::permissions(path, fs::perms::owner_all);
+}
+
+// Sets the directory's mtime explicitly, since two changes inside one clock
+// tick can otherwise leave it untouched.
+void Touch(const fs::path& dir, time_t seconds) {
+  timespec times[2] = {{seconds, 0}, {seconds, 0}};
+  utimensat(AT_FDCWD, dir.c_str(), times, 0);
+}
+}  // namespace
+
+TEST_CASE("PathCache", "[path_cache]") {
+  fs::path root = fs::temp_directory_path() / "shell_path_cache_test";
+  fs::remove_all(root);
+  fs::create_directories(root / "a");
+  fs::create_directories(root / "b");
+  MakeExecutable(root / "b" / "tool");
+  MakeExecutable(root / "b" / "other");
+  std::ofstream{root / "a" / "plain"} << "not executable\n";
+  std::string old_path = getenv("PATH") == NULL ? "" : getenv("PATH");
+  std::string path_env = (root / "a").string() + ":" + (root / "b").string();
+  setenv("PATH", path_env.c_str(), 1);
+
+  SECTION("Caches hits") {
+    spc::PathCache cache{};
+    REQUIRE(cache.lookup("tool") == (root / "b" / "tool").string());
+    REQUIRE(cache.lookup("tool") == (root / "b" / "tool").string());
+    REQUIRE(cache.lookup("plain").empty());
+    REQUIRE(cache.lookup("missing").empty());
+    REQUIRE(cache.size() == 1);
+    auto entries = cache.entries();
+    REQUIRE(entries.size() == 1);
+    REQUIRE(entries[0].name == "tool");
+    REQUIRE(entries[0].hits == 2);
+  }
+
+  SECTION("Directory change invalidates shadowed entries") {
+    spc::PathCache cache{};
+    Touch(root / "a", 1000);
+    Touch(root / "b", 1000);
+    REQUIRE(cache.lookup("tool") == (root / "b" / "tool").string());
+    MakeExecutable(root / "a" / "tool");
+    Touch(root / "a", 2000);
+    REQUIRE(cache.lookup("tool") == (root / "a" / "tool").string());
+  }
+
+  SECTION("PATH change clears the cache") {
+    spc::PathCache cache{};
+    REQUIRE(cache.lookup("tool") == (root / "b" / "tool").string());
+    setenv("PATH", (root / "a").string().c_str(), 1);
+    REQUIRE(cache.lookup("tool").empty());
+    REQUIRE(cache.size() == 0);
+  }
+
+  SECTION("Forget keeps colliding entries reachable") {
+    spc::PathCache cache{};
+    for (int i = 0; i < 200; i++) {
+      cache.remember("cmd" + std::to_string(i), "/bin/" + std::to_string(i));
+    }
+    for (int i = 0; i < 200; i += 2) {
+      REQUIRE(cache.forget("cmd" + std::to_string(i)));
+    }
+    REQUIRE(cache.size() == 100);
+    REQUIRE(!cache.forget("cmd0"));
+    for (int i = 1; i < 200; i += 2) {
+      REQUIRE(cache.lookup("cmd" + std::to_string(i)) ==
+              "/bin/" + std::to_string(i));
+    }
+  }
+
+  SECTION("hash builtin") {
+    spc::PathCache cache{};
+    spc::GLOBAL_COMMAND_CACHE = &cache;
+    auto hash = [](std::vector<std::string_view> args) {
+      return spc::HashCommand(args);
+    };
+    REQUIRE(hash({}) == "hash: hash table empty\n");
+    REQUIRE(hash({"tool"}).empty());
+    REQUIRE(hash({}) ==
+            "hits\tcommand\n   1\t" + (root / "b" / "tool").string() + '\n');
+    REQUIRE(hash({"-l"}) == "builtin hash -p " +
+                                (root / "b" / "tool").string() + " tool\n");
+    REQUIRE_THROWS(hash({"missing"}));
+    REQUIRE(hash({"-r"}).empty());
+    REQUIRE(cache.size() == 0);
+    spc::GLOBAL_COMMAND_CACHE = nullptr;
+  }
+
+  setenv("PATH", old_path.c_str(), 1);
+  fs::remove_all(root);
+}
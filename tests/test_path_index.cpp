@@ -0,0 +1,151 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "path_cache.hpp"
+#include "path_index.hpp"
+#include "trie.hpp"
+
+namespace fs = std::filesystem;
+namespace spc = shell::path_cache;
+namespace spi = shell::path_index;
+
+namespace {
+// Polls `condition` for up to two seconds, since the watcher runs on its own
+// thread.
+template <typename F>
+bool Eventually(F condition) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (condition()) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return condition();
+}
+}  // namespace
+
+TEST_CASE("PathIndexer", "[path_index]") {
+  fs::path root = fs::temp_directory_path() / "shell_path_index_test";
+  fs::remove_all(root);
+  std::vector<std::string> dirs;
+  for (int d = 0; d < 6; d++) {
+    fs::path dir = root / ("bin" + std::to_string(d));
+    fs::create_directories(dir / "subdir");
+    for (int f = 0; f < 300; f++) {
+      fs::path file = dir / ("tool" + std::to_string(f));
+      std::ofstream{file};
+      fs::permissions(file, fs::perms::owner_all);
+    }
+    std::ofstream{dir / "plain"};
+    dirs.push_back(dir.string());
+  }
+  // Same name in two directories and a PATH entry that is a file.
+  dirs.push_back((root / "bin0" / "tool0").string());
+  dirs.push_back((root / "missing").string());
+
+  SECTION("Indexes executables from every entry") {
+    Trie trie = Trie{};
+    spi::PathIndexer indexer{3};
+    indexer.start(&trie, dirs);
+    indexer.wait();
+    REQUIRE(indexer.done());
+    REQUIRE(indexer.indexed() == 6 * 300 + 1);
+    REQUIRE(trie.contains("tool0"));
+    REQUIRE(trie.contains("tool299"));
+    REQUIRE(!trie.contains("plain"));
+    REQUIRE(!trie.contains("subdir"));
+    REQUIRE(trie.getWords("tool").size() == 300);
+  }
+
+  SECTION("Completion works while indexing") {
+    Trie trie = Trie{};
+    trie.insert("echo");
+    spi::PathIndexer indexer{2};
+    indexer.start(&trie, dirs);
+    REQUIRE(trie.getWords("ech") == std::vector<std::string>{"echo"});
+    indexer.wait();
+    REQUIRE(trie.contains("tool42"));
+  }
+
+  fs::remove_all(root);
+}
+
+TEST_CASE("PathWatcher", "[path_index]") {
+  fs::path root = fs::temp_directory_path() / "shell_path_watcher_test";
+  fs::remove_all(root);
+  fs::create_directories(root / "a");
+  fs::create_directories(root / "b");
+  std::vector<std::string> dirs = {(root / "a").string(),
+                                   (root / "b").string()};
+  std::string old_path = getenv("PATH") == NULL ? "" : getenv("PATH");
+  std::string path_env = dirs[0] + ":" + dirs[1];
+  setenv("PATH", path_env.c_str(), 1);
+
+  SECTION("Tracks executables appearing and disappearing") {
+    Trie trie = Trie{};
+    trie.insert("pinned");
+    spc::PathCache cache{};
+    spi::PathWatcher watcher{&trie, &cache, {"pinned"}};
+    REQUIRE(watcher.start(dirs));
+
+    std::ofstream{root / "b" / "tool"};
+    fs::permissions(root / "b" / "tool", fs::perms::owner_all);
+    REQUIRE(Eventually([&] { return trie.contains("tool"); }));
+    REQUIRE(cache.lookup("tool") == (root / "b" / "tool").string());
+
+    // A second copy shadows the first; the cached path must not survive.
+    std::ofstream{root / "a" / "tool"};
+    fs::permissions(root / "a" / "tool", fs::perms::owner_all);
+    REQUIRE(Eventually([&] {
+      return cache.lookup("tool") == (root / "a" / "tool").string();
+    }));
+
+    // Still provided by b, so it stays completable.
+    fs::remove(root / "a" / "tool");
+    REQUIRE(Eventually([&] {
+      return cache.lookup("tool") == (root / "b" / "tool").string();
+    }));
+    REQUIRE(trie.contains("tool"));
+
+    fs::remove(root / "b" / "tool");
+    REQUIRE(Eventually([&] { return !trie.contains("tool"); }));
+    REQUIRE(cache.lookup("tool").empty());
+
+    std::ofstream{root / "a" / "pinned"};
+    fs::remove(root / "a" / "pinned");
+    std::ofstream{root / "a" / "marker"};
+    fs::permissions(root / "a" / "marker", fs::perms::owner_all);
+    REQUIRE(Eventually([&] { return trie.contains("marker"); }));
+    REQUIRE(trie.contains("pinned"));
+    watcher.stop();
+  }
+
+  SECTION("Resyncs after the event queue overflowed") {
+    Trie trie = Trie{};
+    trie.insert("pinned");
+    trie.insert("stale");
+    spc::PathCache cache{};
+    spi::PathWatcher watcher{&trie, &cache, {"pinned"}};
+    REQUIRE(watcher.start(dirs));
+    // Stopped, so that only the rescan sees what changes next.
+    watcher.stop();
+    std::ofstream{root / "b" / "fresh"};
+    fs::permissions(root / "b" / "fresh", fs::perms::owner_all);
+    cache.remember("stale", "/nowhere/stale");
+
+    watcher.rescan();
+    REQUIRE(trie.contains("fresh"));
+    REQUIRE_FALSE(trie.contains("stale"));
+    REQUIRE(trie.contains("pinned"));
+    REQUIRE(cache.size() == 0);
+    REQUIRE(cache.lookup("fresh") == (root / "b" / "fresh").string());
+  }
+
+  setenv("PATH", old_path.c_str(), 1);
+  fs::remove_all(root);
+}
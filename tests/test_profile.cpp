@@ -0,0 +1,148 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "io.hpp"
+#include "profile.hpp"
+
+namespace sprof = shell::profile;
+
+namespace {
+// Runs the `profile` builtin and returns what it printed.
+std::string Profile(std::vector<std::string_view> args) {
+  int fd = open("test_profile.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  {
+    shell::io::OutputSink out{fd};
+    sprof::ProfileCommand(args, &out);
+  }
+  close(fd);
+  std::ifstream file{"test_profile.txt"};
+  std::stringstream ss;
+  ss << file.rdbuf();
+  remove("test_profile.txt");
+  return ss.str();
+}
+}  // namespace
+
+TEST_CASE("Histogram", "[profile]") {
+  using Histogram = sprof::Histogram;
+
+  SECTION("Buckets cover every value within 1/32 of it") {
+    std::vector<uint64_t> values = {0, 1, 31, 32, 33, 63, 64, 65, 1000,
+                                    123456789, UINT64_MAX};
+    for (int shift = 0; shift < 64; shift++) {
+      values.push_back(uint64_t{1} << shift);
+      values.push_back((uint64_t{1} << shift) - 1);
+    }
+    for (uint64_t value : values) {
+      size_t index = Histogram::BucketIndex(value);
+      REQUIRE(index < sprof::kBuckets);
+      REQUIRE(Histogram::BucketLow(index) <= value);
+      REQUIRE(value <= Histogram::BucketHigh(index));
+      REQUIRE(Histogram::BucketHigh(index) - Histogram::BucketLow(index) <=
+              value / sprof::kSubBuckets);
+    }
+    REQUIRE(Histogram::BucketIndex(UINT64_MAX) == sprof::kBuckets - 1);
+    for (size_t i = 1; i < sprof::kBuckets; i++) {
+      REQUIRE(Histogram::BucketLow(i) == Histogram::BucketHigh(i - 1) + 1);
+    }
+  }
+
+  SECTION("Percentiles") {
+    Histogram histogram;
+    REQUIRE(histogram.percentile(0.5) == 0);
+    for (uint64_t value = 1; value <= 10000; value++) {
+      histogram.record(value * 1000);
+    }
+    REQUIRE(histogram.count() == 10000);
+    REQUIRE(histogram.max() == 10000000);
+    REQUIRE(histogram.sum() == 1000ull * 10000 * 10001 / 2);
+    uint64_t p50 = histogram.percentile(0.5);
+    REQUIRE(p50 >= 5000000);
+    REQUIRE(p50 <= 5000000 + 5000000 / 32);
+    uint64_t p99 = histogram.percentile(0.99);
+    REQUIRE(p99 >= 9900000);
+    REQUIRE(p99 <= 9900000 + 9900000 / 32);
+    REQUIRE(histogram.percentile(1) == 10000000);
+    histogram.reset();
+    REQUIRE(histogram.count() == 0);
+    REQUIRE(histogram.max() == 0);
+  }
+
+  SECTION("Records from many threads without losing any") {
+    Histogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+      threads.emplace_back([&histogram, t]() {
+        for (uint64_t i = 0; i < 100000; i++) {
+          histogram.record(i + t);
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    REQUIRE(histogram.count() == 400000);
+    REQUIRE(histogram.max() == 99999 + 3);
+    uint64_t total = 0;
+    for (size_t i = 0; i < sprof::kBuckets; i++) {
+      total += histogram.bucketCount(i);
+    }
+    REQUIRE(total == 400000);
+  }
+}
+
+TEST_CASE("Profile", "[profile]") {
+  sprof::Reset();
+
+  SECTION("Scopes record only while enabled") {
+    { sprof::Scope scope{sprof::Phase::PARSE}; }
+    REQUIRE(sprof::Get(sprof::Phase::PARSE).count() == 0);
+    Profile({"on"});
+    REQUIRE(sprof::Enabled());
+    {
+      sprof::Scope scope{sprof::Phase::PARSE};
+      usleep(1000);
+    }
+    Profile({"off"});
+    { sprof::Scope scope{sprof::Phase::PARSE}; }
+    REQUIRE(sprof::Get(sprof::Phase::PARSE).count() == 1);
+    REQUIRE(sprof::Get(sprof::Phase::PARSE).max() >= 1000000);
+    REQUIRE(sprof::Get(sprof::Phase::SPAWN).count() == 0);
+  }
+
+  SECTION("Shows and exports the histograms") {
+    sprof::Get(sprof::Phase::SPAWN).record(1500);
+    sprof::Get(sprof::Phase::SPAWN).record(2500);
+    std::string table = Profile({});
+    REQUIRE(table.starts_with("phase "));
+    REQUIRE(table.find("spawn               2          1.5          2.5"
+                       "          2.5\n") != std::string::npos);
+    REQUIRE(table.ends_with("`profile on` starts it\n"));
+    std::string json = Profile({"json"});
+    REQUIRE(json.starts_with(
+        "{\"enabled\":false,\"unit\":\"ns\",\"phases\":{\"read\":{\"count\":0,"));
+    REQUIRE(json.find("\"spawn\":{\"count\":2,\"sum\":4000,\"max\":2500,"
+                      "\"p50\":1503,\"p90\":2500,\"p99\":2500,"
+                      "\"p999\":2500,\"buckets\":[[1472,1503,1],"
+                      "[2496,2559,1]]}") != std::string::npos);
+    REQUIRE(json.ends_with("}}\n"));
+    Profile({"reset"});
+    REQUIRE(sprof::Get(sprof::Phase::SPAWN).count() == 0);
+  }
+
+  SECTION("Rejects unknown arguments") {
+    REQUIRE_THROWS_AS(Profile({"sideways"}), std::runtime_error);
+    REQUIRE_THROWS_AS(Profile({"on", "off"}), std::runtime_error);
+  }
+}
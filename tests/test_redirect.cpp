@@ -0,0 +1,114 @@
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include "launcher.hpp"
+#include "parser.hpp"
+#include "redirect.hpp"
+
+namespace fs = std::filesystem;
+namespace launch = shell::launcher;
+namespace sparse = shell::parser;
+namespace sredir = shell::redirect;
+
+namespace {
+std::string ReadFile(const std::string& filename) {
+  std::ifstream read_file{filename};
+  std::stringstream ss;
+  ss << read_file.rdbuf();
+  return ss.str();
+}
+
+// Runs `sh -c script` with `line`'s redirections applied.
+void Run(const std::string& script, const std::string& line) {
+  sparse::Parser parser;
+  const auto& command = parser.parse("sh " + line).pipelines[0].commands[0];
+  sredir::FdTable fds{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+  fds.apply(command.redirects);
+  launch::FileActions actions;
+  fds.install(&actions);
+  pid_t pid = launch::Spawn("/bin/sh", {"sh", "-c", script}, actions);
+  waitpid(pid, NULL, 0);
+}
+}  // namespace
+
+TEST_CASE("FdTable", "[redirect]") {
+  fs::path dir = fs::temp_directory_path() / "shell_test_redirect";
+  fs::remove_all(dir);
+  fs::create_directories(dir);
+  std::string out = (dir / "out").string();
+  std::string err = (dir / "err").string();
+  const char* both = "echo out; echo err >&2";
+
+  SECTION("Truncates, appends and reads files") {
+    Run("echo one", "> " + out);
+    Run("echo two", ">> " + out);
+    REQUIRE(ReadFile(out) == "one\ntwo\n");
+    Run("cat; echo three", "< " + out + " > " + err);
+    REQUIRE(ReadFile(err) == "one\ntwo\nthree\n");
+    Run("echo four", "> " + out);
+    REQUIRE(ReadFile(out) == "four\n");
+  }
+
+  SECTION("Applies several redirections left to right") {
+    Run(both, "> " + out + " 2> " + err);
+    REQUIRE(ReadFile(out) == "out\n");
+    REQUIRE(ReadFile(err) == "err\n");
+    Run(both, "> " + out + " 2>&1");
+    REQUIRE(ReadFile(out) == "out\nerr\n");
+    Run(both, "&> " + err);
+    REQUIRE(ReadFile(err) == "out\nerr\n");
+    Run(both, "&>> " + err);
+    REQUIRE(ReadFile(err) == "out\nerr\nout\nerr\n");
+    // stderr keeps the stdout it had before stdout moved.
+    Run("echo out >&2", "2> " + err + " 3>&2 2>&1 > " + out + " 2>&3");
+    REQUIRE(ReadFile(err) == "out\n");
+    REQUIRE(ReadFile(out).empty());
+  }
+
+  SECTION("Keeps dup'd fds apart when the source moves") {
+    sparse::Parser parser;
+    const auto& command =
+        parser.parse("sh 2>&1 > " + out).pipelines[0].commands[0];
+    sredir::FdTable fds{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    fds.apply(command.redirects);
+    REQUIRE(fds.get(1) >= sredir::kMaxFd);
+    REQUIRE(fds.get(2) != fds.get(1));
+    REQUIRE(fds.get(2) >= sredir::kMaxFd);
+  }
+
+  SECTION("Closes fds and rejects bad ones") {
+    sparse::Parser parser;
+    sredir::FdTable fds{STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+    fds.apply(parser.parse("sh 2>&-").pipelines[0].commands[0].redirects);
+    REQUIRE(fds.get(2) == -1);
+    REQUIRE_THROWS_AS(
+        fds.apply(parser.parse("sh >&2").pipelines[0].commands[0].redirects),
+        std::runtime_error);
+    REQUIRE_THROWS_AS(
+        fds.apply(parser.parse("sh >&7").pipelines[0].commands[0].redirects),
+        std::runtime_error);
+    REQUIRE_THROWS_AS(
+        fds.apply(parser.parse("sh < " + (dir / "missing").string())
+                      .pipelines[0]
+                      .commands[0]
+                      .redirects),
+        std::runtime_error);
+  }
+
+  SECTION("Creates missing directories for output files") {
+    std::string nested = (dir / "a" / "b" / "out").string();
+    Run("echo deep", "> " + nested);
+    REQUIRE(ReadFile(nested) == "deep\n");
+  }
+
+  fs::remove_all(dir);
+}
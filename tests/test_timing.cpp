@@ -0,0 +1,90 @@
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "parser.hpp"
+#include "timing.hpp"
+
+namespace chrono = std::chrono;
+namespace sparse = shell::parser;
+namespace stiming = shell::timing;
+
+TEST_CASE("Usage", "[timing]") {
+  SECTION("Converts rusage") {
+    struct rusage rusage {};
+    rusage.ru_utime = {1, 500000};
+    rusage.ru_stime = {0, 250};
+    rusage.ru_maxrss = 2048;
+    rusage.ru_nvcsw = 3;
+    rusage.ru_nivcsw = 4;
+    auto usage = stiming::FromRusage(rusage);
+    REQUIRE(usage.user == chrono::microseconds(1500000));
+    REQUIRE(usage.sys == chrono::microseconds(250));
+    REQUIRE(usage.max_rss == 2048);
+    REQUIRE(usage.voluntary_switches == 3);
+    REQUIRE(usage.involuntary_switches == 4);
+    REQUIRE(usage.real.count() == 0);
+  }
+
+  SECTION("Adds up stages that ran side by side") {
+    stiming::Usage a;
+    a.real = chrono::milliseconds(5);
+    a.user = chrono::microseconds(10);
+    a.max_rss = 100;
+    a.written = 7;
+    stiming::Usage b = a;
+    b.real = chrono::milliseconds(3);
+    b.max_rss = 300;
+    stiming::Usage total;
+    stiming::Add(&total, a);
+    stiming::Add(&total, b);
+    REQUIRE(total.real == chrono::milliseconds(5));
+    REQUIRE(total.user == chrono::microseconds(20));
+    REQUIRE(total.max_rss == 300);
+    REQUIRE(total.written == 14);
+  }
+
+  SECTION("Reads what a process wrote") {
+    int fd = open("/dev/null", O_WRONLY);
+    REQUIRE(write(fd, "12345", 5) == 5);
+    close(fd);
+    REQUIRE(stiming::Written(getpid()) >= 5);
+    REQUIRE(stiming::Written(-1) == 0);
+  }
+
+  SECTION("Measures the calling thread") {
+    stiming::Stopwatch stopwatch;
+    usleep(10000);
+    auto usage = stopwatch.elapsed();
+    REQUIRE(usage.real >= chrono::milliseconds(10));
+    REQUIRE(usage.voluntary_switches >= 1);
+  }
+}
+
+TEST_CASE("Report", "[timing]") {
+  sparse::Parser parser;
+  const auto& pipeline = parser.parse("time yes | head -n 1").pipelines[0];
+  std::vector<stiming::Usage> stages(2);
+  stages[0].real = chrono::milliseconds(1500);
+  stages[0].written = 4096;
+  stages[1].max_rss = 1024;
+  stiming::Usage total;
+  for (const auto& stage : stages) {
+    stiming::Add(&total, stage);
+  }
+  std::string report = stiming::Report(pipeline, stages, total);
+  REQUIRE(report ==
+          "stage       real      user       sys     maxrss   vcsw  ivcsw"
+          "     written  command\n"
+          "1         1.500s    0.000s    0.000s         0k      0      0"
+          "        4096  yes\n"
+          "2         0.000s    0.000s    0.000s      1024k      0      0"
+          "           0  head -n 1\n"
+          "total     1.500s    0.000s    0.000s      1024k      0      0"
+          "        4096  yes | head -n 1\n");
+}
@@ -0,0 +1,47 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "io.hpp"
+#include "trace.hpp"
+
+namespace strace = shell::trace;
+
+namespace {
+// Runs the `set` builtin and returns what it printed.
+std::string Set(std::vector<std::string_view> args) {
+  int fd = open("test_trace.txt", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  {
+    shell::io::OutputSink out{fd};
+    strace::SetCommand(args, &out);
+  }
+  close(fd);
+  std::ifstream file{"test_trace.txt"};
+  std::stringstream ss;
+  ss << file.rdbuf();
+  remove("test_trace.txt");
+  return ss.str();
+}
+}  // namespace
+
+TEST_CASE("set builtin", "[trace]") {
+  REQUIRE_FALSE(strace::Enabled());
+  REQUIRE(Set({"-o"}) == "xtrace         off\n");
+  Set({"-x"});
+  REQUIRE(strace::Enabled());
+  REQUIRE(Set({"-o"}) == "xtrace         on\n");
+  Set({"+o", "xtrace"});
+  REQUIRE_FALSE(strace::Enabled());
+  Set({"-o", "xtrace", "+x"});
+  REQUIRE_FALSE(strace::Enabled());
+  REQUIRE_THROWS_AS(Set({"-q"}), std::runtime_error);
+  REQUIRE_THROWS_AS(Set({"-o", "emacs"}), std::runtime_error);
+}
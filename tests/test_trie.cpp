@@ -2,6 +2,8 @@
 
 #include <algorithm>
 #include <catch2/catch.hpp>
+#include <random>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -37,4 +39,103 @@ TEST_CASE("UpdateTrieRoot", "[Trie]") {
     REQUIRE(trie.getWords("i") == std::vector<std::string>{});
     REQUIRE(trie.getWords("g") == std::vector<std::string>{"go", "goon"});
   }
+
+  SECTION("Remove") {
+    Trie trie = Trie{};
+    trie.insert("hello");
+    trie.insert("hell");
+    trie.insert("help");
+    REQUIRE(trie.size() == 6);
+    REQUIRE(!trie.remove("he"));
+    REQUIRE(trie.remove("hello"));
+    REQUIRE(!trie.contains("hello"));
+    REQUIRE(trie.contains("hell"));
+    REQUIRE(trie.size() == 5);
+    REQUIRE(trie.remove("hell"));
+    REQUIRE(!trie.remove("hell"));
+    REQUIRE(trie.contains("help"));
+    REQUIRE(trie.size() == 4);
+    REQUIRE(trie.getWords("h") == std::vector<std::string>{"help"});
+  }
+
+  SECTION("Matches a reference set under random edits") {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> letter('a', 'd');
+    std::uniform_int_distribution<int> length(1, 6);
+    Trie trie = Trie{};
+    std::set<std::string> reference;
+    for (int step = 0; step < 4000; step++) {
+      std::string word;
+      for (int i = length(rng); i > 0; i--) word += letter(rng);
+      if (rng() % 3 == 0) {
+        REQUIRE(trie.remove(word) == (reference.erase(word) == 1));
+      } else {
+        trie.insert(word);
+        reference.insert(word);
+      }
+      REQUIRE(trie.contains(word) == (reference.count(word) == 1));
+    }
+    std::set<std::string> prefixes;
+    for (const auto& word : reference) {
+      for (size_t i = 1; i <= word.size(); i++) prefixes.insert(word.substr(0, i));
+    }
+    REQUIRE(trie.size() == static_cast<int>(prefixes.size()));
+    for (std::string prefix : {"a", "ab", "bca", "dddd", "c"}) {
+      std::vector<std::string> expected;
+      for (const auto& word : reference) {
+        if (word.starts_with(prefix)) expected.push_back(word);
+      }
+      REQUIRE(trie.getWords(prefix) == expected);
+    }
+  }
+
+  SECTION("Bounded enumeration and common prefix") {
+    Trie trie = Trie{};
+    for (std::string word : {"gzip", "git", "git-shell", "git-receive-pack",
+                             "git-upload-pack", "gawk"}) {
+      trie.insert(word);
+    }
+    REQUIRE(trie.getWords("g", 3) ==
+            std::vector<std::string>{"gawk", "git", "git-receive-pack"});
+    std::vector<std::string> seen;
+    size_t visited = trie.forEachWord("git-", 10, [&seen](std::string_view w) {
+      seen.emplace_back(w);
+      return w != "git-shell";
+    });
+    REQUIRE(visited == 2);
+    REQUIRE(seen == std::vector<std::string>{"git-receive-pack", "git-shell"});
+    REQUIRE(trie.longestCommonPrefix("g") == "g");
+    REQUIRE(trie.longestCommonPrefix("git-") == "git-");
+    REQUIRE(trie.longestCommonPrefix("git-u") == "git-upload-pack");
+    REQUIRE(trie.longestCommonPrefix("gi") == "git");
+    REQUIRE(trie.longestCommonPrefix("gz") == "gzip");
+    REQUIRE(trie.longestCommonPrefix("x") == "x");
+    trie.insert("gitk");
+    trie.remove("git");
+    REQUIRE(trie.longestCommonPrefix("gi") == "git");
+  }
+
+  SECTION("Reclaims labels of removed words") {
+    Trie trie = Trie{};
+    std::vector<std::string> words;
+    for (int i = 0; i < 200; i++) {
+      words.push_back("command-number-" + std::to_string(i));
+    }
+    trie.insertAll(words);
+    size_t initial = trie.labelBytes();
+    // A PATH entry that keeps disappearing and coming back.
+    for (int round = 0; round < 100; round++) {
+      for (size_t i = 0; i < words.size(); i += 2) {
+        REQUIRE(trie.remove(words[i]));
+      }
+      for (size_t i = 0; i < words.size(); i += 2) {
+        trie.insert(words[i]);
+      }
+    }
+    REQUIRE(trie.labelBytes() < 4 * initial + 8192);
+    REQUIRE(trie.getWords("command-number-1", 1000).size() == 111);
+    for (const auto& word : words) {
+      REQUIRE(trie.contains(word));
+    }
+  }
 }
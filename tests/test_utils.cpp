@@ -1,189 +1,19 @@
+#include <unistd.h>
+
+#include <algorithm>
 #include <catch2/catch.hpp>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "io.hpp"
 #include "utils.hpp"
 
-TEST_CASE("StripBeginningWhitespace", "[string]") {
-  SECTION("Empty string") { REQUIRE(StripBeginningWhitespace("") == ""); }
-
-  SECTION("No whitespace") {
-    REQUIRE(StripBeginningWhitespace("hello") == "hello");
-  }
-
-  SECTION("Leading whitespace") {
-    REQUIRE(StripBeginningWhitespace("   hello") == "hello");
-  }
-
-  SECTION("Trailing whitespace") {
-    REQUIRE(StripBeginningWhitespace("hello   ") == "hello   ");
-  }
-
-  SECTION("Only whitespace") { REQUIRE(StripBeginningWhitespace("   ") == ""); }
-
-  SECTION("Multiple spaces before words") {
-    REQUIRE(StripBeginningWhitespace("   hello world") == "hello world");
-  }
-}
-
-TEST_CASE("StripEndingWhitespace", "[string]") {
-  SECTION("Empty string") { REQUIRE(StripEndingWhitespace("") == ""); }
-
-  SECTION("No whitespace") {
-    REQUIRE(StripEndingWhitespace("hello") == "hello");
-  }
-
-  SECTION("Leading whitespace") {
-    REQUIRE(StripEndingWhitespace("   hello") == "   hello");
-  }
-
-  SECTION("Trailing whitespace") {
-    REQUIRE(StripEndingWhitespace("hello   ") == "hello");
-  }
-
-  SECTION("Only whitespace") { REQUIRE(StripEndingWhitespace("   ") == ""); }
-
-  SECTION("Multiple spaces after words") {
-    REQUIRE(StripEndingWhitespace("hello world    ") == "hello world");
-  }
-}
-
-TEST_CASE("ParseRedirection", "[redirect]") {
-  SECTION("No >") {
-    auto info = ParseRedirection("echo test 1");
-    REQUIRE(info.input == "echo test 1");
-    REQUIRE(info.file.empty());
-    REQUIRE(info.type == RedirectType::NONE);
-  }
-
-  SECTION("With >") {
-    auto info = ParseRedirection("echo test > file.txt");
-    REQUIRE(info.input == "echo test");
-    REQUIRE(info.file == "file.txt");
-    REQUIRE(info.type == RedirectType::OUTPUT);
-    REQUIRE(info.open_mode == std::ios_base::out);
-  }
-
-  SECTION("With >>") {
-    auto info = ParseRedirection("echo test >> file.txt");
-    REQUIRE(info.input == "echo test");
-    REQUIRE(info.file == "file.txt");
-    REQUIRE(info.type == RedirectType::OUTPUT);
-    REQUIRE(info.open_mode == std::ios_base::app);
-  }
-
-  SECTION("With 2>>") {
-    auto info = ParseRedirection("echo test 2>> file.txt");
-    REQUIRE(info.input == "echo test");
-    REQUIRE(info.file == "file.txt");
-    REQUIRE(info.type == RedirectType::ERROR);
-    REQUIRE(info.open_mode == std::ios_base::app);
-  }
-
-  SECTION("With 1>") {
-    auto info = ParseRedirection("echo test 1> file.txt");
-    REQUIRE(info.input == "echo test");
-    REQUIRE(info.file == "file.txt");
-    REQUIRE(info.type == RedirectType::OUTPUT);
-    REQUIRE(info.open_mode == std::ios_base::out);
-  }
-
-  SECTION("With 2>") {
-    auto info = ParseRedirection("echo test 2> file.txt");
-    REQUIRE(info.input == "echo test");
-    REQUIRE(info.file == "file.txt");
-    REQUIRE(info.type == RedirectType::ERROR);
-    REQUIRE(info.open_mode == std::ios_base::out);
-  }
-
-  SECTION("Command has number") {
-    auto info = ParseRedirection("echo test 1> file1.txt");
-    REQUIRE(info.input == "echo test");
-    REQUIRE(info.file == "file1.txt");
-    REQUIRE(info.type == RedirectType::OUTPUT);
-    REQUIRE(info.open_mode == std::ios_base::out);
-  }
-}
-
-TEST_CASE("GetCommandAndArgs", "[string]") {
-  SECTION("Single Arg") {
-    auto [command, arg] = GetCommandAndArgs(" cat /tmp/bee/f1");
-    REQUIRE(command == "cat");
-    REQUIRE(arg == "/tmp/bee/f1");
-  }
-
-  SECTION("No Arg") {
-    auto [command, arg] = GetCommandAndArgs(" ls ");
-    REQUIRE(command == "ls");
-    REQUIRE(arg == "");
-
-    auto [command2, arg2] = GetCommandAndArgs("ls");
-    REQUIRE(command2 == "ls");
-    REQUIRE(arg2 == "");
-  }
-
-  SECTION("Exec with space") {
-    auto [command, arg] = GetCommandAndArgs(" 'exe  with  space' /tmp/bee/f1");
-    REQUIRE(command == "exe  with  space");
-    REQUIRE(arg == "/tmp/bee/f1");
-  }
-
-  SECTION("Exec with single quote") {
-    auto [command, arg] =
-        GetCommandAndArgs("\"exe with \\'single quotes\\'\" /tmp/ant/f3");
-    REQUIRE(command == "exe with \\'single quotes\\'");
-    REQUIRE(arg == "/tmp/ant/f3");
-  }
-
-  SECTION("Echo") {
-    auto [command, arg] = GetCommandAndArgs("echo \"James says Error\"");
-    REQUIRE(command == "echo");
-    REQUIRE(arg == "\"James says Error\"");
-  }
-}
-
-TEST_CASE("SplitText", "[pipes]") {
-  SECTION("Single Pipe") {
-    std::vector<std::string> expected = {"cat /tmp/bee/f1"};
-    REQUIRE(SplitText(" cat /tmp/bee/f1", '|') == expected);
-  }
-
-  SECTION("Multi Pipe") {
-    std::vector<std::string> expected = {"cat /tmp/bee/f1", "echo hi there",
-                                         "echo hey there"};
-    REQUIRE(SplitText(" cat /tmp/bee/f1 | echo hi there | echo hey there",
-                      '|') == expected);
-  }
-
-  SECTION("Multi space") {
-    std::vector<std::string> expected = {"cat", "tmp"};
-    REQUIRE(SplitText("cat  tmp  ", ' ') == expected);
-  }
-
-  SECTION("confusing cat") {
-    auto res = SplitText("cat \"/tmp/pig/\\\"f 43\\\"\"", ' ', true);
-    std::vector<std::string> expected = {"cat", "/tmp/pig/\"f 43\""};
-    REQUIRE(res == expected);
-  }
-
-  SECTION("confusing cat 2") {
-    auto res = SplitText(
-        "cat '/tmp/bee/f   21' '/tmp/bee/f   58' '/tmp/bee/f   18'", ' ', true);
-    std::vector<std::string> expected = {"cat", "/tmp/bee/f   21",
-                                         "/tmp/bee/f   58", "/tmp/bee/f   18"};
-    REQUIRE(res == expected);
-  }
-
-  SECTION("confusing cat 3") {
-    auto res = SplitText(
-        "cat \"/tmp/ant/'f 27'\" \"/tmp/ant/'f  \\96'\" \"/tmp/ant/'f "
-        "\\15\\'\"",
-        ' ', true);
-    std::vector<std::string> expected = {
-        "cat", "/tmp/ant/'f 27'", "/tmp/ant/'f  \\96'", "/tmp/ant/'f \\15\\'"};
-    REQUIRE(res == expected);
-  }
-}
+namespace sio = shell::io;
 
 TEST_CASE("Echo", "[echo]") {
   SECTION("Simple Echo") { REQUIRE(EchoCommand("Hi   there") == "Hi there\n"); }
@@ -208,24 +38,61 @@ TEST_CASE("Echo", "[echo]") {
   }
 }
 
-TEST_CASE("GetOptions", "[options]") {
-  SECTION("No options") {
-    std::vector<std::string> expected = {"Hi there"};
-    REQUIRE(GetOptions("Hi there") == expected);
-  }
+TEST_CASE("FindInPathEntry", "[path]") {
+  fs::path root = fs::temp_directory_path() / "shell_find_in_path_test";
+  fs::remove_all(root);
+  fs::create_directories(root / "subdir");
+  std::ofstream{root / "tool"} << "#!/bin/sh\n";
+  fs::permissions(root / "tool", fs::perms::owner_all);
+  std::ofstream{root / "plain"} << "text\n";
 
-  SECTION("one option + extra") {
-    std::vector<std::string> expected = {"-e", "Hi there"};
-    REQUIRE(GetOptions("-e Hi there") == expected);
+  SECTION("Directory entry") {
+    REQUIRE(FindInPathEntry(root.string(), "tool") == (root / "tool").string());
+    REQUIRE(FindInPathEntry(root.string(), "plain").empty());
+    REQUIRE(FindInPathEntry(root.string(), "subdir").empty());
+    REQUIRE(FindInPathEntry(root.string(), "missing").empty());
+    REQUIRE(FindInPathEntry(root.string(), "subdir/../tool").empty());
   }
 
-  SECTION("two options + extra") {
-    std::vector<std::string> expected = {"-e", "-f", "Hi there"};
-    REQUIRE(GetOptions("-e -f Hi there") == expected);
+  SECTION("File entry") {
+    REQUIRE(FindInPathEntry((root / "tool").string(), "tool") ==
+            (root / "tool").string());
+    REQUIRE(FindInPathEntry((root / "tool").string(), "other").empty());
   }
 
-  SECTION("two options") {
-    std::vector<std::string> expected = {"-e", "-f"};
-    REQUIRE(GetOptions("-e -f") == expected);
-  }
+  fs::remove_all(root);
+}
+
+TEST_CASE("TypeCommand", "[path]") {
+  fs::path root = fs::temp_directory_path() / "shell_type_test";
+  fs::remove_all(root);
+  fs::create_directories(root);
+  std::ofstream{root / "tool"} << "#!/bin/sh\n";
+  fs::permissions(root / "tool", fs::perms::owner_all);
+  std::string old_path = getenv("PATH") == NULL ? "" : getenv("PATH");
+  setenv("PATH", root.c_str(), 1);
+
+  int pipefd[2];
+  REQUIRE(pipe(pipefd) == 0);
+  std::vector<std::string_view> args = {"echo", "nosuch", "tool", "gone"};
+  std::string error;
+  {
+    sio::OutputSink out{pipefd[1]};
+    try {
+      TypeCommand(args, {"echo"}, &out);
+    } catch (const std::runtime_error& e) {
+      error = e.what();
+    }
+  }
+  close(pipefd[1]);
+  std::string output(256, '\0');
+  output.resize(std::max<ssize_t>(read(pipefd[0], output.data(), 256), 0));
+  close(pipefd[0]);
+  // What was found is still written; only the misses are errors.
+  REQUIRE(output == "echo is a shell builtin\ntool is " +
+                        (root / "tool").string() + "\n");
+  REQUIRE(error == "nosuch: not found\ngone: not found");
+
+  setenv("PATH", old_path.c_str(), 1);
+  fs::remove_all(root);
 }